@@ -0,0 +1,57 @@
+/*
+Assimp2Json
+Copyright (c) 2011, Alexander C. Gessler
+
+Licensed under a 3-clause BSD license. See the LICENSE file for more information.
+
+*/
+
+#include <atomic>
+#include <new>
+#include <cstdlib>
+
+#include "alloc_counter.h"
+#include "stats.h"
+
+// operator new and operator delete live in their own translation unit so the
+// compiler never sees them inlined into each other's callers, which GCC would
+// otherwise report as mismatched new/free pairs.
+
+namespace {
+	std::atomic<bool> count_allocations(false);
+	std::atomic<size_t> allocations(0), allocated_bytes(0);
+
+	void ReadAllocationCounters(size_t& count, size_t& bytes)
+	{
+		count = allocations.load(std::memory_order_relaxed);
+		bytes = allocated_bytes.load(std::memory_order_relaxed);
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+void EnableAllocationCounting()
+{
+	ConversionStats::SetAllocationCounter(&ReadAllocationCounters);
+	count_allocations = true;
+}
+
+// ------------------------------------------------------------------------------------------------
+void* operator new(size_t n)
+{
+	if (count_allocations.load(std::memory_order_relaxed)) {
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		allocated_bytes.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	void* const p = std::malloc(n ? n : 1);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+// ------------------------------------------------------------------------------------------------
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
@@ -0,0 +1,25 @@
+/*
+Assimp2Json
+Copyright (c) 2011, Alexander C. Gessler
+
+Licensed under a 3-clause BSD license. See the LICENSE file for more information.
+
+*/
+
+#ifndef INCLUDED_ALLOC_COUNTER
+#define INCLUDED_ALLOC_COUNTER
+
+// ----------------------------------------------------------------------------
+// Counts heap allocations for --stats by replacing the global operator new.
+// This also covers allocations made by assimp unless it is a DLL on Windows,
+// which brings its own operator new. Link alloc_counter.cpp into executables
+// only, never into a library.
+// ----------------------------------------------------------------------------
+
+// ---------------------------------------------------------------------------
+/** Starts counting allocations and registers the counter with
+ *  ConversionStats. Counting costs two atomic increments per allocation,
+ *  so it is off until this is called. */
+void EnableAllocationCounting();
+
+#endif // INCLUDED_ALLOC_COUNTER
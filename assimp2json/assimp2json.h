@@ -0,0 +1,247 @@
+/*
+Assimp2Json
+Copyright (c) 2011, Alexander C. Gessler
+
+Licensed under a 3-clause BSD license. See the LICENSE file for more information.
+
+*/
+
+#ifndef INCLUDED_ASSIMP2JSON
+#define INCLUDED_ASSIMP2JSON
+
+// ----------------------------------------------------------------------------
+// Public interface of libassimp2json, for converting scenes to JSON in-process.
+//
+//   Assimp::Importer imp;
+//   const aiScene* scene = imp.ReadFile("model.obj", aiProcessPreset_TargetRealtime_MaxQuality);
+//
+//   std::string json;
+//   Assimp2JsonBufferSink sink(json);
+//   Assimp2JsonOptions options;
+//   options.compact = true;
+//   if (!Assimp2JsonWrite(scene, sink, options, &error)) { ... }
+//
+// Unlike going through Assimp::Exporter, the scene is not copied before it
+// is written. The library can also be used as an exporter, see
+// Assimp2Json_desc in json_exporter.h.
+// ----------------------------------------------------------------------------
+
+#include <string>
+#include <cstddef>
+
+#include "json_exporter.h"
+
+struct aiScene;
+
+// ---------------------------------------------------------------------------
+/** Compression of the JSON document, see Assimp2JsonOptions::compression. */
+enum Assimp2JsonCompression
+{
+	// by the output file name's suffix: .gz, .zst or .br, otherwise none.
+	// Output to a sink is not compressed.
+	Assimp2JsonCompression_Auto,
+
+	Assimp2JsonCompression_None,
+	Assimp2JsonCompression_Gzip,
+	Assimp2JsonCompression_Zstd,
+	Assimp2JsonCompression_Brotli
+};
+
+// ---------------------------------------------------------------------------
+/** Encoding of triangle indices, see ASSIMP2JSON_CONFIG_INDEX_ENCODING. */
+enum Assimp2JsonIndexEncoding
+{
+	Assimp2JsonIndexEncoding_None,
+	Assimp2JsonIndexEncoding_Delta,
+	Assimp2JsonIndexEncoding_Watermark
+};
+
+// ---------------------------------------------------------------------------
+/** Settings for one conversion. They correspond to the ASSIMP2JSON_CONFIG_XXX
+ *  exporter properties documented in json_exporter.h, and the defaults are
+ *  the same.
+ */
+struct Assimp2JsonOptions
+{
+	Assimp2JsonOptions()
+		: compact(false)
+		, binary_buffers(false)
+		, threads(1)
+		, split_limit(1 << 16)
+		, split_locality(false)
+		, optimize_vertex_cache(false)
+		, compression(Assimp2JsonCompression_Auto)
+		, compression_level(0)
+		, quantize(false)
+		, position_bits(16)
+		, normal_bits(12)
+		, index_encoding(Assimp2JsonIndexEncoding_None)
+		, flat_indices(false)
+	{}
+
+	// read the options from a set of exporter properties, NULL gives the defaults
+	static Assimp2JsonOptions FromProperties(const Assimp::ExportProperties* props);
+
+	// ASSIMP2JSON_CONFIG_COMPACT
+	bool compact;
+
+	// ASSIMP2JSON_CONFIG_BINARY_BUFFERS, only honoured by Assimp2JsonWriteFile()
+	// since the sidecar files are created next to the output file.
+	bool binary_buffers;
+
+	// ASSIMP2JSON_CONFIG_THREADS, 0 for one thread per hardware thread
+	unsigned int threads;
+
+	// ASSIMP2JSON_CONFIG_SPLIT_LIMIT, 0 to disable splitting
+	unsigned int split_limit;
+
+	// ASSIMP2JSON_CONFIG_SPLIT_LOCALITY
+	bool split_locality;
+
+	// ASSIMP2JSON_CONFIG_OPTIMIZE_VERTEX_CACHE
+	bool optimize_vertex_cache;
+
+	// codec the JSON document is compressed with. Binary sidecar files are not
+	// compressed. Codecs the library was built without make the conversion fail.
+	Assimp2JsonCompression compression;
+
+	// ASSIMP2JSON_CONFIG_COMPRESSION_LEVEL
+	int compression_level;
+
+	// ASSIMP2JSON_CONFIG_QUANTIZE
+	bool quantize;
+
+	// ASSIMP2JSON_CONFIG_QUANTIZE_POSITION_BITS
+	unsigned int position_bits;
+
+	// ASSIMP2JSON_CONFIG_QUANTIZE_NORMAL_BITS
+	unsigned int normal_bits;
+
+	// ASSIMP2JSON_CONFIG_INDEX_ENCODING
+	Assimp2JsonIndexEncoding index_encoding;
+
+	// ASSIMP2JSON_CONFIG_FLAT_INDICES
+	bool flat_indices;
+};
+
+
+// ---------------------------------------------------------------------------
+/** Receives the JSON document in order, in chunks of up to a few megabytes.
+ *  Write() is always called on the thread that called Assimp2JsonWrite().
+ */
+class Assimp2JsonSink
+{
+
+public:
+
+	virtual ~Assimp2JsonSink() {}
+
+public:
+
+	// append `size` bytes to the output. Return false on errors, the rest of
+	// the document is then discarded and Assimp2JsonWrite() fails.
+	virtual bool Write(const char* data, size_t size) = 0;
+};
+
+
+// ---------------------------------------------------------------------------
+/** Hands the output to a plain function, for example to feed a network
+ *  connection or a compressor.
+ */
+class Assimp2JsonCallbackSink : public Assimp2JsonSink
+{
+
+public:
+
+	typedef bool (*Callback)(const char* data, size_t size, void* user);
+
+	Assimp2JsonCallbackSink(Callback callback, void* user = NULL)
+		: callback(callback)
+		, user(user)
+	{}
+
+public:
+
+	bool Write(const char* data, size_t size) {
+		return callback(data, size, user);
+	}
+
+private:
+	Callback callback;
+	void* user;
+};
+
+
+// ---------------------------------------------------------------------------
+/** Appends the output to a string owned by the caller. */
+class Assimp2JsonBufferSink : public Assimp2JsonSink
+{
+
+public:
+
+	explicit Assimp2JsonBufferSink(std::string& buffer)
+		: buffer(buffer)
+	{}
+
+public:
+
+	bool Write(const char* data, size_t size) {
+		buffer.append(data, size);
+		return true;
+	}
+
+private:
+	std::string& buffer;
+};
+
+
+// ---------------------------------------------------------------------------
+/** Writes the output to a file descriptor, i.e. stdout, a pipe or a socket.
+ *  The descriptor is not closed.
+ */
+class Assimp2JsonFileDescriptorSink : public Assimp2JsonSink
+{
+
+public:
+
+	explicit Assimp2JsonFileDescriptorSink(int fd)
+		: fd(fd)
+	{}
+
+public:
+
+	bool Write(const char* data, size_t size);
+
+private:
+	const int fd;
+};
+
+
+// ---------------------------------------------------------------------------
+/** Writes a scene as JSON to a sink. Safe to call concurrently on different
+ *  scenes, or on the same scene since it is not modified.
+ *
+ *  @param scene Scene to be written.
+ *  @param sink Receives the document.
+ *  @param options Conversion settings, binary_buffers is ignored.
+ *  @param error If given, receives a description of the error on failure.
+ *  @return true on success, false if the sink failed or the scene could
+ *    not be written. */
+bool Assimp2JsonWrite(const aiScene* scene, Assimp2JsonSink& sink,
+	const Assimp2JsonOptions& options = Assimp2JsonOptions(), std::string* error = NULL);
+
+// ---------------------------------------------------------------------------
+/** Writes a scene as JSON to a file, and its binary sidecar files next to
+ *  it if options.binary_buffers is set.
+ *
+ *  @param scene Scene to be written.
+ *  @param file Output file name.
+ *  @param options Conversion settings.
+ *  @param error If given, receives a description of the error on failure.
+ *  @param io IOSystem to create the files with, NULL writes to disk.
+ *  @return true on success. */
+bool Assimp2JsonWriteFile(const aiScene* scene, const char* file,
+	const Assimp2JsonOptions& options = Assimp2JsonOptions(), std::string* error = NULL,
+	Assimp::IOSystem* io = NULL);
+
+#endif // INCLUDED_ASSIMP2JSON
@@ -0,0 +1,574 @@
+/*
+Assimp2Json
+Copyright (c) 2011, Alexander C. Gessler
+
+Licensed under a 3-clause BSD license. See the LICENSE file for more information.
+
+*/
+
+#include "compressed_io.h"
+
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+
+#ifdef ASSIMP2JSON_WITH_ZLIB
+#	include <zlib.h>
+#endif
+#ifdef ASSIMP2JSON_WITH_ZSTD
+#	include <zstd.h>
+#endif
+#ifdef ASSIMP2JSON_WITH_BROTLI
+#	include <brotli/encode.h>
+#endif
+
+// size of the buffer compressed data is collected in before it is written out
+#define OUTPUT_BUFFER_SIZE (1u << 18)
+
+// number of chunks the writer may get ahead of the background thread. Chunks are a few
+// megabytes, so this bounds the memory spent on the hand-over.
+#define MAX_PENDING_CHUNKS 4
+
+
+// one compressed stream of a codec. Encode() is only ever called on one thread at a time.
+class CompressedIOStream::Encoder
+{
+
+public:
+
+	explicit Encoder(Assimp::IOStream& out)
+		: out(out)
+		, collect()
+		, buffer(OUTPUT_BUFFER_SIZE)
+	{}
+
+	virtual ~Encoder() {}
+
+public:
+
+	// compress `size` bytes, and end the stream if `finish` is set. Returns false on errors.
+	virtual bool Encode(const char* data, size_t size, bool finish) = 0;
+
+	// append the compressed data to `s` instead of writing it to the output. NULL
+	// goes back to writing to the output.
+	void CollectInto(std::string* s) {
+		collect = s;
+	}
+
+protected:
+
+	// write the first `size` bytes of `buffer` to the output
+	bool Emit(size_t size) {
+		if(collect) {
+			collect->append(&buffer[0], size);
+			return true;
+		}
+		return !size || out.Write(&buffer[0], 1, size) == size;
+	}
+
+protected:
+	Assimp::IOStream& out;
+	std::string* collect;
+	std::vector<char> buffer;
+};
+
+namespace {
+
+#ifdef ASSIMP2JSON_WITH_ZLIB
+
+class GzipEncoder : public CompressedIOStream::Encoder
+{
+
+public:
+
+	GzipEncoder(Assimp::IOStream& out, int level)
+		: Encoder(out)
+		, ok()
+	{
+		memset(&zs, 0, sizeof zs);
+		// 16 added to the window bits selects the gzip wrapper over zlib's own
+		ok = deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+	}
+
+	~GzipEncoder() {
+		if(ok) {
+			deflateEnd(&zs);
+		}
+	}
+
+public:
+
+	bool IsOpen() const {
+		return ok;
+	}
+
+	bool Encode(const char* data, size_t size, bool finish) {
+		// zlib counts in uInt, so hand over very large blocks in slices
+		do {
+			const size_t n = std::min(size, static_cast<size_t>(1u << 30));
+			const int flush = finish && n == size ? Z_FINISH : Z_NO_FLUSH;
+
+			zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+			zs.avail_in = static_cast<uInt>(n);
+			int ret;
+			do {
+				zs.next_out = reinterpret_cast<Bytef*>(&buffer[0]);
+				zs.avail_out = static_cast<uInt>(buffer.size());
+				ret = deflate(&zs, flush);
+				if(ret == Z_STREAM_ERROR || !Emit(buffer.size() - zs.avail_out)) {
+					return false;
+				}
+			}
+			while(zs.avail_out == 0);
+
+			if(flush == Z_FINISH && ret != Z_STREAM_END) {
+				return false;
+			}
+			data += n;
+			size -= n;
+		}
+		while(size);
+		return true;
+	}
+
+private:
+	z_stream zs;
+	bool ok;
+};
+
+#endif // ASSIMP2JSON_WITH_ZLIB
+
+#ifdef ASSIMP2JSON_WITH_ZSTD
+
+class ZstdEncoder : public CompressedIOStream::Encoder
+{
+
+public:
+
+	ZstdEncoder(Assimp::IOStream& out, int level, unsigned int threads)
+		: Encoder(out)
+		, cctx(ZSTD_createCCtx())
+	{
+		if(cctx) {
+			ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+
+			// fails harmlessly if libzstd was built without multithreading support
+			if(threads > 1) {
+				ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, static_cast<int>(threads));
+			}
+		}
+	}
+
+	~ZstdEncoder() {
+		ZSTD_freeCCtx(cctx);
+	}
+
+public:
+
+	bool IsOpen() const {
+		return cctx != NULL;
+	}
+
+	bool Encode(const char* data, size_t size, bool finish) {
+		ZSTD_inBuffer in = { data, size, 0 };
+		for(;;) {
+			ZSTD_outBuffer o = { &buffer[0], buffer.size(), 0 };
+			const size_t remaining = ZSTD_compressStream2(cctx, &o, &in, finish ? ZSTD_e_end : ZSTD_e_continue);
+			if(ZSTD_isError(remaining) || !Emit(o.pos)) {
+				return false;
+			}
+
+			// with worker threads, input may be taken in several steps
+			if(finish ? remaining == 0 : in.pos == in.size) {
+				return true;
+			}
+		}
+	}
+
+private:
+	ZSTD_CCtx* const cctx;
+};
+
+#endif // ASSIMP2JSON_WITH_ZSTD
+
+#ifdef ASSIMP2JSON_WITH_BROTLI
+
+class BrotliEncoder : public CompressedIOStream::Encoder
+{
+
+public:
+
+	BrotliEncoder(Assimp::IOStream& out, int level)
+		: Encoder(out)
+		, state(BrotliEncoderCreateInstance(NULL, NULL, NULL))
+	{
+		if(state) {
+			BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY, static_cast<uint32_t>(level));
+			BrotliEncoderSetParameter(state, BROTLI_PARAM_MODE, BROTLI_MODE_TEXT);
+		}
+	}
+
+	~BrotliEncoder() {
+		if(state) {
+			BrotliEncoderDestroyInstance(state);
+		}
+	}
+
+public:
+
+	bool IsOpen() const {
+		return state != NULL;
+	}
+
+	bool Encode(const char* data, size_t size, bool finish) {
+		const uint8_t* next_in = reinterpret_cast<const uint8_t*>(data);
+		size_t avail_in = size;
+		for(;;) {
+			uint8_t* next_out = reinterpret_cast<uint8_t*>(&buffer[0]);
+			size_t avail_out = buffer.size();
+			if(!BrotliEncoderCompressStream(state, finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS,
+				&avail_in, &next_in, &avail_out, &next_out, NULL) || !Emit(buffer.size() - avail_out)) {
+				return false;
+			}
+
+			if(finish ? BrotliEncoderIsFinished(state) : !avail_in && !BrotliEncoderHasMoreOutput(state)) {
+				return true;
+			}
+		}
+	}
+
+private:
+	BrotliEncoderState* const state;
+};
+
+#endif // ASSIMP2JSON_WITH_BROTLI
+
+struct CodecInfo
+{
+	Assimp2JsonCompression codec;
+	const char* name;
+	const char* suffix;
+	int min_level, max_level, default_level;
+};
+
+// brotli's own default quality of 11 is an order of magnitude slower than 9, which
+// compresses almost as well
+const CodecInfo codecs[] = {
+	{ Assimp2JsonCompression_Gzip,   "gzip",   ".gz",  1, 9,  6 },
+	{ Assimp2JsonCompression_Zstd,   "zstd",   ".zst", 1, 22, 3 },
+	{ Assimp2JsonCompression_Brotli, "brotli", ".br",  1, 11, 9 },
+};
+
+const CodecInfo* FindCodec(Assimp2JsonCompression codec)
+{
+	for(size_t i = 0; i < sizeof(codecs) / sizeof(codecs[0]); ++i) {
+		if(codecs[i].codec == codec) {
+			return &codecs[i];
+		}
+	}
+	return NULL;
+}
+
+} // !anon
+
+
+// ------------------------------------------------------------------------------------------------
+CompressedIOStream* CompressedIOStream :: Create(Assimp::IOStream& out, Assimp2JsonCompression codec, int level,
+	unsigned int threads, std::string* error)
+{
+	const CodecInfo* const info = FindCodec(codec);
+	if(!info) {
+		if(error) {
+			*error = "unknown compression codec";
+		}
+		return NULL;
+	}
+
+	if(!level) {
+		level = info->default_level;
+	}
+	if(level < info->min_level || level > info->max_level) {
+		if(error) {
+			std::ostringstream ss;
+			ss << info->name << " compression levels range from " << info->min_level << " to " << info->max_level;
+			*error = ss.str();
+		}
+		return NULL;
+	}
+
+	Encoder* encoder = NULL;
+	bool open = false;
+	switch(codec) {
+#ifdef ASSIMP2JSON_WITH_ZLIB
+		case Assimp2JsonCompression_Gzip: {
+			GzipEncoder* const gzip = new GzipEncoder(out, level);
+			open = gzip->IsOpen();
+			encoder = gzip;
+			break;
+		}
+#endif
+#ifdef ASSIMP2JSON_WITH_ZSTD
+		case Assimp2JsonCompression_Zstd: {
+			ZstdEncoder* const zstd = new ZstdEncoder(out, level, threads);
+			open = zstd->IsOpen();
+			encoder = zstd;
+			break;
+		}
+#endif
+#ifdef ASSIMP2JSON_WITH_BROTLI
+		case Assimp2JsonCompression_Brotli: {
+			BrotliEncoder* const brotli = new BrotliEncoder(out, level);
+			open = brotli->IsOpen();
+			encoder = brotli;
+			break;
+		}
+#endif
+		default:
+			if(error) {
+				*error = std::string(info->name) + " compression is not available in this build";
+			}
+			return NULL;
+	}
+
+	if(!open) {
+		delete encoder;
+		if(error) {
+			*error = std::string("failure setting up ") + info->name + " compression";
+		}
+		return NULL;
+	}
+	return new CompressedIOStream(out, encoder, threads > 1);
+}
+
+// ------------------------------------------------------------------------------------------------
+Assimp2JsonCompression CompressedIOStream :: CodecFromFileName(const std::string& file, std::string* base_name)
+{
+	for(size_t i = 0; i < sizeof(codecs) / sizeof(codecs[0]); ++i) {
+		const size_t len = strlen(codecs[i].suffix);
+		if(file.length() > len && !file.compare(file.length() - len, len, codecs[i].suffix)) {
+			if(base_name) {
+				*base_name = file.substr(0, file.length() - len);
+			}
+			return codecs[i].codec;
+		}
+	}
+
+	if(base_name) {
+		*base_name = file;
+	}
+	return Assimp2JsonCompression_None;
+}
+
+// ------------------------------------------------------------------------------------------------
+CompressedIOStream :: CompressedIOStream(Assimp::IOStream& out, Encoder* encoder, bool background)
+	: out(out)
+	, encoder(encoder)
+	, pos()
+	, finished()
+	, failed()
+	, finishing()
+	, stopped()
+{
+	if(background) {
+		worker = std::thread(&CompressedIOStream::CompressPending, this);
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+CompressedIOStream :: ~CompressedIOStream()
+{
+	Finish();
+	delete encoder;
+}
+
+// ------------------------------------------------------------------------------------------------
+bool CompressedIOStream :: Finish()
+{
+	if(!finished) {
+		finished = true;
+		if(worker.joinable()) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				finishing = true;
+			}
+			cond.notify_all();
+
+			// keep writing what the background thread hands back until it is done
+			bool ok = true;
+			for(bool done = false; !done; ) {
+				std::deque<std::string> output;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					cond.wait(lock, [&]() { return !compressed.empty() || stopped; });
+					output.swap(compressed);
+					done = stopped;
+				}
+				if(ok) {
+					ok = WriteCompressed(output);
+				}
+			}
+			worker.join();
+		}
+		else if(!failed) {
+			failed = !encoder->Encode(NULL, 0, true);
+		}
+	}
+	return !failed;
+}
+
+// ------------------------------------------------------------------------------------------------
+void CompressedIOStream :: CompressPending()
+{
+	// the sink may only be written to on the caller's thread, so the compressed data is
+	// collected here and handed back
+	std::string output;
+	encoder->CollectInto(&output);
+
+	bool ok = true;
+	for(;;) {
+		std::string chunk;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [&]() { return !pending.empty() || finishing || failed; });
+			if(failed || pending.empty()) {
+				ok = !failed;
+				break;
+			}
+			chunk.swap(pending.front());
+			pending.pop_front();
+			if(!spare.empty()) {
+				output.swap(spare.back());
+				spare.pop_back();
+			}
+		}
+
+		output.clear();
+		ok = encoder->Encode(chunk.data(), chunk.length(), false);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			failed = failed || !ok;
+			spare.push_back(std::string());
+			spare.back().swap(chunk);
+			compressed.push_back(std::string());
+			compressed.back().swap(output);
+		}
+		cond.notify_all();
+		if(!ok) {
+			break;
+		}
+	}
+
+	output.clear();
+	if(ok) {
+		ok = encoder->Encode(NULL, 0, true);
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		failed = failed || !ok;
+		if(ok) {
+			compressed.push_back(std::string());
+			compressed.back().swap(output);
+		}
+		stopped = true;
+	}
+	cond.notify_all();
+}
+
+// ------------------------------------------------------------------------------------------------
+bool CompressedIOStream :: WriteCompressed(std::deque<std::string>& output)
+{
+	bool ok = true;
+	for(std::deque<std::string>::const_iterator it = output.begin(); it != output.end() && ok; ++it) {
+		ok = (*it).empty() || out.Write((*it).data(), 1, (*it).length()) == (*it).length();
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	failed = failed || !ok;
+	for(std::deque<std::string>::iterator it = output.begin(); it != output.end(); ++it) {
+		spare.push_back(std::string());
+		spare.back().swap(*it);
+	}
+	return ok;
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t CompressedIOStream :: Read(void*, size_t, size_t)
+{
+	return 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t CompressedIOStream :: Write(const void* pvBuffer, size_t pSize, size_t pCount)
+{
+	const size_t size = pSize * pCount;
+	if(finished || !size) {
+		return 0;
+	}
+
+	if(!worker.joinable()) {
+		if(failed || !encoder->Encode(static_cast<const char*>(pvBuffer), size, false)) {
+			failed = true;
+			return 0;
+		}
+		pos += size;
+		return pCount;
+	}
+
+	// the caller reuses its buffer, so the chunk is copied into one the background thread
+	// has already finished with. Compressed data handed back so far is written out
+	// meanwhile.
+	std::string chunk;
+	std::deque<std::string> output;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		cond.wait(lock, [&]() { return pending.size() < MAX_PENDING_CHUNKS || failed; });
+		if(failed) {
+			return 0;
+		}
+		if(!spare.empty()) {
+			chunk.swap(spare.back());
+			spare.pop_back();
+		}
+		output.swap(compressed);
+	}
+	chunk.assign(static_cast<const char*>(pvBuffer), size);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending.push_back(std::string());
+		pending.back().swap(chunk);
+	}
+	cond.notify_all();
+
+	if(!WriteCompressed(output)) {
+		// wakes the background thread up to stop
+		cond.notify_all();
+		return 0;
+	}
+	pos += size;
+	return pCount;
+}
+
+// ------------------------------------------------------------------------------------------------
+aiReturn CompressedIOStream :: Seek(size_t, aiOrigin)
+{
+	return aiReturn_FAILURE;
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t CompressedIOStream :: Tell() const
+{
+	return pos;
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t CompressedIOStream :: FileSize() const
+{
+	return pos;
+}
+
+// ------------------------------------------------------------------------------------------------
+void CompressedIOStream :: Flush()
+{
+	// nothing to do, the compressed stream is only ended by Finish()
+}
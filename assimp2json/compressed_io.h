@@ -0,0 +1,106 @@
+/*
+Assimp2Json
+Copyright (c) 2011, Alexander C. Gessler
+
+Licensed under a 3-clause BSD license. See the LICENSE file for more information.
+
+*/
+
+#ifndef INCLUDED_COMPRESSED_IO
+#define INCLUDED_COMPRESSED_IO
+
+#include <assimp/IOStream.hpp>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+#include "assimp2json.h"
+
+// ---------------------------------------------------------------------------
+/** Write-only Assimp::IOStream which compresses everything written to it
+ *  into another stream, as a single gzip, zstd or brotli stream. Codecs are
+ *  only available if the library was built with them, see CMakeLists.txt.
+ *
+ *  With more than one thread, the data is compressed on a background
+ *  thread so that compression overlaps with producing the data. zstd also
+ *  compresses with that many worker threads of its own. The compressed data
+ *  is handed back and written to the underlying stream on the thread that
+ *  calls Write() and Finish(), never on the background thread. Flush() does
+ *  not end the compressed stream, Finish() does.
+ */
+class CompressedIOStream : public Assimp::IOStream
+{
+
+public:
+
+	class Encoder;
+
+	// returns NULL and sets `error` if the codec is not available or the level is out of
+	// range for it. `level` 0 selects the codec's default level. `out` must outlive the stream.
+	static CompressedIOStream* Create(Assimp::IOStream& out, Assimp2JsonCompression codec, int level,
+		unsigned int threads, std::string* error = NULL);
+
+	// codec for a file name by its suffix: .gz, .zst or .br. If `base_name` is given, it
+	// receives the name without the suffix.
+	static Assimp2JsonCompression CodecFromFileName(const std::string& file, std::string* base_name = NULL);
+
+	// Finish()es the stream if that wasn't done yet
+	~CompressedIOStream();
+
+public:
+
+	// compress all remaining data and end the compressed stream. Returns false if
+	// compressing or writing to the underlying stream failed at any point.
+	bool Finish();
+
+public:
+
+	size_t Read(void* pvBuffer, size_t pSize, size_t pCount);
+	size_t Write(const void* pvBuffer, size_t pSize, size_t pCount);
+	aiReturn Seek(size_t pOffset, aiOrigin pOrigin);
+	size_t Tell() const;
+	size_t FileSize() const;
+	void Flush();
+
+private:
+
+	CompressedIOStream(Assimp::IOStream& out, Encoder* encoder, bool background);
+
+	// body of the background thread
+	void CompressPending();
+
+	// write compressed data handed back by the background thread to `out` and recycle
+	// its buffers. Returns false if writing failed.
+	bool WriteCompressed(std::deque<std::string>& output);
+
+private:
+
+	// no copying
+	CompressedIOStream(const CompressedIOStream&);
+	CompressedIOStream& operator=(const CompressedIOStream&);
+
+private:
+	Assimp::IOStream& out;
+	Encoder* const encoder;
+	size_t pos;
+	bool finished;
+
+	// everything below is shared with the background thread and guarded by `mutex`
+	bool failed;
+	bool finishing;
+	bool stopped;
+	std::deque<std::string> pending;
+	std::deque<std::string> compressed;
+	std::vector<std::string> spare;
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::thread worker;
+};
+
+#endif // INCLUDED_COMPRESSED_IO
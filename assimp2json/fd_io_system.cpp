@@ -0,0 +1,148 @@
+/*
+Assimp2Json
+Copyright (c) 2011, Alexander C. Gessler
+
+Licensed under a 3-clause BSD license. See the LICENSE file for more information.
+
+*/
+
+#include "fd_io_system.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#ifdef _WIN32
+#	include <io.h>
+#	define fd_read(fd, buf, n) _read(fd, buf, static_cast<unsigned int>(n))
+#	define fd_write(fd, buf, n) _write(fd, buf, static_cast<unsigned int>(n))
+#	define fd_close _close
+#	define fd_create(name) _open(name, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE)
+#	define fd_stat _stat
+#	define fd_stat_t struct _stat
+#else
+#	include <unistd.h>
+#	define fd_read read
+#	define fd_write write
+#	define fd_close close
+#	define fd_create(name) open(name, O_WRONLY | O_CREAT | O_TRUNC, 0666)
+#	define fd_stat stat
+#	define fd_stat_t struct stat
+#endif
+
+// ------------------------------------------------------------------------------------------------
+FileDescriptorIOStream :: ~FileDescriptorIOStream()
+{
+	if (close_fd) {
+		fd_close(fd);
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t FileDescriptorIOStream :: Read(void* pvBuffer, size_t pSize, size_t pCount)
+{
+	const size_t total = pSize * pCount;
+	size_t done = 0;
+	while (done < total) {
+		const long n = static_cast<long>(fd_read(fd, static_cast<char*>(pvBuffer) + done, total - done));
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			break;
+		}
+		done += static_cast<size_t>(n);
+	}
+
+	pos += done;
+	return pSize ? done / pSize : 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t FileDescriptorIOStream :: Write(const void* pvBuffer, size_t pSize, size_t pCount)
+{
+	// pipes and sockets may accept less than we offer, keep going until all is written
+	const size_t total = pSize * pCount;
+	size_t done = 0;
+	while (done < total) {
+		const long n = static_cast<long>(fd_write(fd, static_cast<const char*>(pvBuffer) + done, total - done));
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			break;
+		}
+		done += static_cast<size_t>(n);
+	}
+
+	pos += done;
+	return pSize ? done / pSize : 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+aiReturn FileDescriptorIOStream :: Seek(size_t, aiOrigin)
+{
+	return aiReturn_FAILURE;
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t FileDescriptorIOStream :: Tell() const
+{
+	return pos;
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t FileDescriptorIOStream :: FileSize() const
+{
+	return pos;
+}
+
+// ------------------------------------------------------------------------------------------------
+void FileDescriptorIOStream :: Flush()
+{
+	// nothing to do, we don't buffer
+}
+
+// ------------------------------------------------------------------------------------------------
+bool OutputFileIOSystem :: Exists( const char* pFile) const
+{
+	fd_stat_t st;
+	return fd_stat(pFile, &st) == 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+char OutputFileIOSystem :: getOsSeparator() const
+{
+#ifdef _WIN32
+	return '\\';
+#else
+	return '/';
+#endif
+}
+
+// ------------------------------------------------------------------------------------------------
+Assimp::IOStream* OutputFileIOSystem :: Open(const char* pFile, const char* pMode)
+{
+	if (!strchr(pMode, 'w')) {
+		return NULL;
+	}
+
+	int fd;
+	do {
+		fd = fd_create(pFile);
+	}
+	while (fd < 0 && errno == EINTR);
+
+	if (fd < 0) {
+		return NULL;
+	}
+	return new FileDescriptorIOStream(fd, true);
+}
+
+// ------------------------------------------------------------------------------------------------
+void OutputFileIOSystem :: Close( Assimp::IOStream* pFile)
+{
+	delete pFile;
+}
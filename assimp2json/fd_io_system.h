@@ -0,0 +1,69 @@
+/*
+Assimp2Json
+Copyright (c) 2011, Alexander C. Gessler
+
+Licensed under a 3-clause BSD license. See the LICENSE file for more information.
+
+*/
+
+#ifndef INCLUDED_FD_IO_SYSTEM
+#define INCLUDED_FD_IO_SYSTEM
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+// ---------------------------------------------------------------------------
+/** Unbuffered Assimp::IOStream on top of a file descriptor, i.e. stdout or
+ *  a socket. Writers are expected to do their own buffering, as JSONWriter
+ *  does, so every Write() goes straight to the descriptor.
+ */
+class FileDescriptorIOStream : public Assimp::IOStream
+{
+
+public:
+
+	explicit FileDescriptorIOStream(int fd, bool close_fd = false)
+		: fd(fd)
+		, close_fd(close_fd)
+		, pos()
+	{}
+
+	~FileDescriptorIOStream();
+
+public:
+
+	size_t Read(void* pvBuffer, size_t pSize, size_t pCount);
+	size_t Write(const void* pvBuffer, size_t pSize, size_t pCount);
+
+	// descriptors are treated as non-seekable streams, Tell() and FileSize()
+	// return the number of bytes read or written so far.
+	aiReturn Seek(size_t pOffset, aiOrigin pOrigin);
+	size_t Tell() const;
+	size_t FileSize() const;
+	void Flush();
+
+private:
+	const int fd;
+	const bool close_fd;
+	size_t pos;
+};
+
+
+// ---------------------------------------------------------------------------
+/** Assimp::IOSystem which creates files on disk for writing, each of them
+ *  opened as a FileDescriptorIOStream. Files cannot be opened for reading.
+ */
+class OutputFileIOSystem : public Assimp::IOSystem
+{
+
+public:
+
+	bool Exists( const char* pFile) const;
+	char getOsSeparator() const;
+
+	// files are always created or truncated, in binary mode
+	Assimp::IOStream* Open(const char* pFile, const char* pMode = "wb");
+	void Close( Assimp::IOStream* pFile);
+};
+
+#endif // INCLUDED_FD_IO_SYSTEM
@@ -13,16 +13,39 @@ Licensed under a 3-clause BSD license. See the LICENSE file for more information
 
 #include <assimp/scene.h>
 
+#include <ostream>
 #include <sstream>
+#include <streambuf>
+#include <vector>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
 #include <limits>
+#include <algorithm>
+#include <cmath>
 #include <cassert>
+#include <cstring>
+#include <stdint.h>
 
 #define CURRENT_FORMAT_VERSION 100
 
+// precision of quantized texture coordinates and vertex colors, see ASSIMP2JSON_CONFIG_QUANTIZE
+#define QUANTIZED_TEXCOORD_BITS 16
+#define QUANTIZED_COLOR_BITS 8
+
 // grab scoped_ptr from assimp to avoid a dependency on boost. 
 #include <assimp/../../code/BoostWorkaround/boost/scoped_ptr.hpp>
 
+#include "json_exporter.h"
+#include "assimp2json.h"
+#include "fd_io_system.h"
+#include "compressed_io.h"
 #include "mesh_splitter.h"
+#include "number_format.h"
+#include "stats.h"
 
 
 extern "C" {
@@ -43,6 +66,312 @@ Assimp::Exporter::ExportFormatEntry Assimp2Json_desc = Assimp::Exporter::ExportF
 namespace {
 
 
+	// stream buffer with a fixed-size chunk of memory that is handed over to an
+	// Assimp::IOStream whenever it fills up. This keeps the writer's memory footprint
+	// constant, regardless of how large the output document grows.
+class ChunkedStreamBuf : public std::streambuf
+{
+
+public:
+
+	static const size_t DefaultChunkSize = 1u << 21;
+
+	// for writers which go to memory anyway
+	static const size_t SmallChunkSize = 1u << 16;
+
+public:
+
+	ChunkedStreamBuf(Assimp::IOStream& out, size_t chunk_size = DefaultChunkSize)
+		: out(out)
+		, chunk(new char[chunk_size])
+		, chunk_size(chunk_size)
+		, written()
+		, failed()
+	{
+		setp(chunk, chunk + chunk_size);
+	}
+
+	~ChunkedStreamBuf()
+	{
+		delete[] chunk;
+	}
+
+public:
+
+	// get a pointer to at least n bytes of contiguous free space, n must not exceed
+	// the chunk size. Follow up with Commit() to append the bytes actually written.
+	char* Reserve(size_t n) {
+		if(static_cast<size_t>(epptr() - pptr()) < n) {
+			FlushChunk();
+		}
+		return pptr();
+	}
+
+	void Commit(size_t n) {
+		pbump(static_cast<int>(n));
+	}
+
+	// hand all buffered characters to the output stream
+	void FlushChunk() {
+		const size_t n = static_cast<size_t>(pptr() - pbase());
+		if(n) {
+			WriteOut(pbase(),n);
+		}
+		setp(chunk, chunk + chunk_size);
+	}
+
+	// total number of characters written so far, including those still buffered
+	size_t Tell() const {
+		return written + static_cast<size_t>(pptr() - pbase());
+	}
+
+	// true if the output stream did not accept all of the characters handed to it
+	bool Failed() const {
+		return failed;
+	}
+
+protected:
+
+	int_type overflow(int_type c) {
+		FlushChunk();
+		if(!traits_type::eq_int_type(c, traits_type::eof())) {
+			*pptr() = traits_type::to_char_type(c);
+			pbump(1);
+		}
+		return traits_type::not_eof(c);
+	}
+
+	std::streamsize xsputn(const char* s, std::streamsize n) {
+		const size_t len = static_cast<size_t>(n);
+		if(len > static_cast<size_t>(epptr() - pptr())) {
+			FlushChunk();
+
+			// blocks which would not fit into an empty chunk either go straight to the output
+			if(len >= chunk_size) {
+				WriteOut(s,len);
+				return n;
+			}
+		}
+		memcpy(pptr(),s,len);
+		pbump(static_cast<int>(len));
+		return n;
+	}
+
+	int sync() {
+		FlushChunk();
+		return 0;
+	}
+
+private:
+
+	// std::ostream swallows exceptions from its buffer, and the last chunk is written from
+	// JSONWriter's destructor, so an output stream which throws counts as failed instead
+	void WriteOut(const char* s, size_t n) {
+		try {
+			failed |= out.Write(s,n,1) != 1;
+		}
+		catch(...) {
+			failed = true;
+		}
+		written += n;
+	}
+
+private:
+
+	// no copying
+	ChunkedStreamBuf(const ChunkedStreamBuf&);
+	ChunkedStreamBuf& operator=(const ChunkedStreamBuf&);
+
+private:
+	Assimp::IOStream& out;
+	char* const chunk;
+	const size_t chunk_size;
+	size_t written;
+	bool failed;
+};
+
+
+	// in-memory Assimp::IOStream, used to format parts of the document which are written out later
+class MemoryIOStream : public Assimp::IOStream
+{
+
+public:
+
+	size_t Read(void*, size_t, size_t) {
+		return 0;
+	}
+
+	size_t Write(const void* pvBuffer, size_t pSize, size_t pCount) {
+		data.append(static_cast<const char*>(pvBuffer), pSize * pCount);
+		return pCount;
+	}
+
+	aiReturn Seek(size_t, aiOrigin) {
+		return aiReturn_FAILURE;
+	}
+
+	size_t Tell() const {
+		return data.length();
+	}
+
+	size_t FileSize() const {
+		return data.length();
+	}
+
+	void Flush() {
+	}
+
+public:
+	std::string data;
+};
+
+
+	// collects large numeric arrays in one or more little-endian binary sidecar
+	// files next to the JSON document. The document only references them.
+class BinaryBuffers
+{
+
+public:
+
+	// start a new file once the current one would grow beyond this size
+	static const size_t DefaultMaxFileSize = 1u << 30;
+
+	// location of a block of data in the sidecar files
+	struct Ref {
+		unsigned int buffer;
+		size_t byte_offset;
+	};
+
+	struct FileInfo {
+		std::string uri;
+		size_t byte_length;
+	};
+
+public:
+
+	BinaryBuffers(Assimp::IOSystem& io, const std::string& json_file, size_t max_file_size = DefaultMaxFileSize)
+		: io(io)
+		, stream()
+		, max_file_size(max_file_size)
+	{
+		// model.assimp.json -> model.assimp.bin, model.assimp.1.bin, ...
+		base_name = json_file;
+		const std::string::size_type ext = base_name.rfind(".json");
+		if(ext != std::string::npos && ext == base_name.length() - 5) {
+			base_name.erase(ext);
+		}
+		OpenFile();
+	}
+
+	~BinaryBuffers()
+	{
+		if(stream) {
+			io.Close(stream);
+		}
+	}
+
+public:
+
+	bool IsOpen() const {
+		return stream != NULL;
+	}
+
+	const std::vector<FileInfo>& GetFiles() const {
+		return files;
+	}
+
+	// start a new block of data. It must be followed by Write() calls which add up to exactly `bytes`.
+	Ref Begin(size_t bytes) {
+		if(files.back().byte_length && files.back().byte_length + bytes > max_file_size) {
+			// keep writing to the current file if we can't get a new one, the limit is only a soft one
+			Assimp::IOStream* const prev = stream;
+			if(OpenFile()) {
+				io.Close(prev);
+			}
+		}
+
+		Ref ref;
+		ref.buffer = static_cast<unsigned int>(files.size() - 1);
+		ref.byte_offset = files.back().byte_length;
+		files.back().byte_length += bytes;
+		return ref;
+	}
+
+	// append words of `word_size` bytes to the current block, they are byte-swapped if the host
+	// is not little-endian
+	void Write(const void* data, size_t bytes, size_t word_size = 4) {
+		if(word_size == 1 || IsLittleEndian()) {
+			stream->Write(data,bytes,1);
+			return;
+		}
+
+		const char* const in = static_cast<const char*>(data);
+		char tmp[4096];
+		for(size_t ofs = 0; ofs < bytes; ofs += sizeof tmp) {
+			const size_t n = std::min(sizeof tmp, bytes - ofs);
+			for(size_t i = 0; i < n; i += word_size) {
+				for(size_t b = 0; b < word_size; ++b) {
+					tmp[i+b] = in[ofs+i+word_size-1-b];
+				}
+			}
+			stream->Write(tmp,n,1);
+		}
+	}
+
+	Ref Append(const void* data, size_t bytes) {
+		const Ref ref = Begin(bytes);
+		Write(data, bytes);
+		return ref;
+	}
+
+private:
+
+	static bool IsLittleEndian() {
+		const uint32_t one = 1;
+		return *reinterpret_cast<const unsigned char*>(&one) == 1;
+	}
+
+	bool OpenFile() {
+		std::ostringstream name;
+		name << base_name;
+		if(!files.empty()) {
+			name << '.' << files.size();
+		}
+		name << ".bin";
+
+		Assimp::IOStream* const next = io.Open(name.str().c_str(),"wb");
+		if(!next) {
+			return false;
+		}
+		stream = next;
+
+		// the document refers to the sidecar files relative to its own location
+		FileInfo info;
+		info.uri = name.str();
+		const std::string::size_type sep = info.uri.find_last_of("/\\");
+		if(sep != std::string::npos) {
+			info.uri.erase(0, sep + 1);
+		}
+		info.byte_length = 0;
+		files.push_back(info);
+		return true;
+	}
+
+private:
+
+	// no copying
+	BinaryBuffers(const BinaryBuffers&);
+	BinaryBuffers& operator=(const BinaryBuffers&);
+
+private:
+	Assimp::IOSystem& io;
+	Assimp::IOStream* stream;
+	std::string base_name;
+	std::vector<FileInfo> files;
+	const size_t max_file_size;
+};
+
+
 	// small utility class to simplify serializing the aiScene to Json
 class JSONWriter
 {
@@ -52,17 +381,54 @@ public:
 	enum {
 		Flag_DoNotIndent = 0x1,
 		Flag_WriteSpecialFloats = 0x2,
+		// no insignificant whitespace at all, implies Flag_DoNotIndent
+		Flag_Compact = 0x4,
 	};
 
 public:
 
-	JSONWriter(Assimp::IOStream& out, unsigned int flags = 0u)
-		: out(out)
+	JSONWriter(Assimp::IOStream& out, unsigned int flags = 0u, BinaryBuffers* buffers = NULL)
+		: chunks(out)
+		, buff(&chunks)
 		, first()
 		, flags(flags)
+		, buffers(buffers)
+		, threads(1)
+		, position_bits()
+		, normal_bits()
+		, index_encoding(Assimp2JsonIndexEncoding_None)
+		, flat_indices()
 	{
 		// make sure that all formatting happens using the standard, C locale and not the user's current locale
 		buff.imbue( std::locale("C") );
+
+		if(flags & Flag_Compact) {
+			this->flags |= Flag_DoNotIndent;
+		}
+		else {
+			newline = "\n";
+			space = " ";
+		}
+	}
+
+	// continue the array or object `parent` is currently at in a separate writer, i.e. with
+	// the same settings and indentation. `first` tells whether the next element is its first.
+	JSONWriter(Assimp::IOStream& out, const JSONWriter& parent, bool first)
+		: chunks(out, ChunkedStreamBuf::SmallChunkSize)
+		, indent(parent.indent)
+		, newline(parent.newline)
+		, space(parent.space)
+		, buff(&chunks)
+		, first(first)
+		, flags(parent.flags)
+		, buffers(parent.buffers)
+		, threads(1)
+		, position_bits(parent.position_bits)
+		, normal_bits(parent.normal_bits)
+		, index_encoding(parent.index_encoding)
+		, flat_indices(parent.flat_indices)
+	{
+		buff.imbue( std::locale("C") );
 	}
 
 	~JSONWriter()
@@ -73,9 +439,69 @@ public:
 public:
 
 	void Flush()	{
-		const std::string s = buff.str();
-		out.Write(s.c_str(),s.length(),1);
-		buff.clear();
+		chunks.FlushChunk();
+	}
+
+	// number of characters written so far
+	size_t Tell() const {
+		return chunks.Tell();
+	}
+
+	// true if writing to the output stream failed, only reliable after Flush()
+	bool Failed() const {
+		return chunks.Failed();
+	}
+
+	// if set, large numeric arrays go to binary sidecar files instead
+	BinaryBuffers* GetBinaryBuffers() const {
+		return buffers;
+	}
+
+	// maximum number of threads to format parts of the document concurrently. Writers
+	// which continue another writer always get 1, so there is no nested parallelism.
+	void SetThreads(unsigned int n) {
+		threads = std::max(1u, n);
+	}
+
+	unsigned int GetThreads() const {
+		return threads;
+	}
+
+	// quantize vertex positions to `position_bits` bits and write directions in octahedral
+	// encoding with `normal_bits` bits per component. 0, 0 writes all attributes as floats.
+	void SetQuantization(unsigned int position_bits, unsigned int normal_bits) {
+		this->position_bits = position_bits;
+		this->normal_bits = normal_bits;
+	}
+
+	bool IsQuantizing() const {
+		return position_bits != 0;
+	}
+
+	unsigned int GetPositionBits() const {
+		return position_bits;
+	}
+
+	unsigned int GetNormalBits() const {
+		return normal_bits;
+	}
+
+	// encoding of the indices of triangle meshes, which are then written as one flat stream
+	void SetIndexEncoding(Assimp2JsonIndexEncoding encoding) {
+		index_encoding = encoding;
+	}
+
+	Assimp2JsonIndexEncoding GetIndexEncoding() const {
+		return index_encoding;
+	}
+
+	// write the indices of triangle meshes as one flat array, implied by an index encoding
+	void SetFlatIndices(bool flat) {
+		flat_indices = flat;
+	}
+
+	bool GetFlatIndices() const {
+		return flat_indices || index_encoding != Assimp2JsonIndexEncoding_None;
 	}
 
 	void PushIndent() {
@@ -89,7 +515,7 @@ public:
 	void Key(const std::string& name) {
 		AddIndentation();
 		Delimit();
-		buff << '\"'+name+"\": ";
+		buff << '\"' << name << "\":" << space;
 	}
 
 	template<typename Literal>
@@ -97,12 +523,48 @@ public:
 		AddIndentation();
 		Delimit();
 
-		LiteralToString(buff, name) << '\n';
+		LiteralToString(buff, name) << newline;
+	}
+
+	// write a run of integers as array elements, equivalent to calling
+	// Element() for each of them but without going through the generic path.
+	template<typename Int>
+	void Elements(const Int* values, size_t count) {
+		const size_t ind = flags & Flag_DoNotIndent ? 0 : indent.length();
+		for(size_t i = 0; i < count; ++i) {
+			char* const begin = chunks.Reserve(ind + NUMBER_FORMAT_MAX_INT_CHARS + 2);
+			char* cur = begin;
+
+			memcpy(cur, indent.data(), ind);
+			cur += ind;
+
+			if(!first) {
+				*cur++ = ',';
+			}
+			else {
+				memcpy(cur, space.data(), space.length());
+				cur += space.length();
+				first = false;
+			}
+
+			cur += FormatInteger(values[i], cur);
+
+			memcpy(cur, newline.data(), newline.length());
+			cur += newline.length();
+			chunks.Commit(static_cast<size_t>(cur - begin));
+		}
+	}
+
+	// append array elements which have been formatted by a writer obtained
+	// from JSONWriter(IOStream&, const JSONWriter&, bool).
+	void ElementsRaw(const std::string& text) {
+		buff.write(text.data(), text.length());
+		first = false;
 	}
 
 	template<typename Literal>
 	void SimpleValue(const Literal& s) {
-		LiteralToString(buff, s) << '\n';
+		LiteralToString(buff, s) << newline;
 	}
 
 
@@ -110,21 +572,19 @@ public:
 		base64_encodestate s;
 		base64_init_encodestate(&s);
 
-		char* const out = new char[std::max(len*2, static_cast<size_t>(16u))];
-		const int n = base64_encode_block(reinterpret_cast<const char*>( buffer ), static_cast<int>( len ),out,&s);
-		out[n+base64_encode_blockend(out + n,&s)] = '\0';
+		// encode block-wise so we never hold more than a small, fixed amount of
+		// base64 text in memory, even for huge embedded textures.
+		const size_t block = 3 * 1024;
+		char out[block * 2 + 16];
 
-		// base64 encoding may add newlines, but JSON strings may not contain 'real' newlines
-		// (only escaped ones). Remove any newlines in out.
-		for(char* cur = out; *cur; ++cur) {
-			if(*cur == '\n') {
-				*cur = ' ';
-			}
+		buff << '\"';
+		const char* const in = reinterpret_cast<const char*>( buffer );
+		for(size_t ofs = 0; ofs < len; ofs += block) {
+			const int n = base64_encode_block(in + ofs, static_cast<int>( std::min(block, len - ofs) ),out,&s);
+			WriteBase64(out, n);
 		}
-
-
-		buff << '\"' << out << "\"\n";
-		delete[] out;
+		WriteBase64(out, base64_encode_blockend(out,&s));
+		buff << '\"' << newline;
 	} 
 
 	void StartObj(bool is_element = false) {
@@ -136,7 +596,7 @@ public:
 			}
 		}
 		first = true;
-		buff << "{\n";
+		buff << '{' << newline;
 		PushIndent();
 	}
 
@@ -144,7 +604,7 @@ public:
 		PopIndent();
 		AddIndentation();
 		first = false;
-		buff << "}\n";
+		buff << '}' << newline;
 	}
 
 	void StartArray(bool is_element = false) {
@@ -156,14 +616,14 @@ public:
 			}
 		}
 		first = true;
-		buff << "[\n";
+		buff << '[' << newline;
 		PushIndent();
 	}
 
 	void EndArray() {
 		PopIndent();
 		AddIndentation();
-		buff << "]\n";
+		buff << ']' << newline;
 		first = false;
 	}
 
@@ -178,20 +638,39 @@ public:
 			buff << ',';
 		}
 		else {
-			buff << ' ';		
+			buff << space;
 			first = false;
 		}
 	}
 
 private:
 
+	static size_t FormatInteger(unsigned int u, char* out) {
+		return FormatUInt(u, out);
+	}
+
+	static size_t FormatInteger(int i, char* out) {
+		return FormatInt(i, out);
+	}
+
+	void WriteBase64(char* out, int n) {
+		// base64 encoding may add newlines, but JSON strings may not contain 'real' newlines
+		// (only escaped ones). Remove any newlines in out.
+		for(char* cur = out; cur != out + n; ++cur) {
+			if(*cur == '\n') {
+				*cur = ' ';
+			}
+		}
+		buff.write(out, n);
+	}
+
 	template<typename Literal>
-	std::stringstream& LiteralToString(std::stringstream& stream, const Literal& s) {
+	std::ostream& LiteralToString(std::ostream& stream, const Literal& s) {
 		stream << s;
 		return stream;
 	}
 
-	std::stringstream& LiteralToString(std::stringstream& stream, const aiString& s) {
+	std::ostream& LiteralToString(std::ostream& stream, const aiString& s) {
 		std::string t;
 
 		// escape backslashes and single quotes, both would render the JSON invalid if left as is
@@ -210,8 +689,27 @@ private:
 		return stream;
 	}
 
-	std::stringstream& LiteralToString(std::stringstream& stream, float f) {
-		if (!std::numeric_limits<float>::is_iec559) {
+	std::ostream& LiteralToString(std::ostream& stream, unsigned int u) {
+		chunks.Commit(FormatUInt(u, chunks.Reserve(NUMBER_FORMAT_MAX_INT_CHARS)));
+		return stream;
+	}
+
+	std::ostream& LiteralToString(std::ostream& stream, int i) {
+		chunks.Commit(FormatInt(i, chunks.Reserve(NUMBER_FORMAT_MAX_INT_CHARS)));
+		return stream;
+	}
+
+	std::ostream& LiteralToString(std::ostream& stream, float f) {
+		return RealToString(stream, f);
+	}
+
+	std::ostream& LiteralToString(std::ostream& stream, double f) {
+		return RealToString(stream, f);
+	}
+
+	template<typename Real>
+	std::ostream& RealToString(std::ostream& stream, Real f) {
+		if (!std::numeric_limits<Real>::is_iec559) {
 			// on a non IEEE-754 platform, we make no assumptions about the representation or existence
 			// of special floating-point numbers. 
 			stream << f;
@@ -222,7 +720,7 @@ private:
 		// [RFC 4672: "Numeric values that cannot be represented as sequences of digits
 		// (such as Infinity and NaN) are not permitted."]
 		// Nevertheless, many parsers will accept the special keywords Infinity, -Infinity and NaN
-		if (std::numeric_limits<float>::infinity() == fabs(f)) {
+		if (std::numeric_limits<Real>::infinity() == fabs(f)) {
 			if (flags & Flag_WriteSpecialFloats) {
 				stream << (f < 0 ? "\"-" : "\"") + std::string( "Infinity\"" );
 				return stream;
@@ -244,89 +742,712 @@ private:
 			return stream;
 		}
 
-		stream << f;
+		// format straight into the output chunk, shortest representation that reads back bit-exact
+		WriteReal(f);
 		return stream;
 	}
 
+	void WriteReal(float f) {
+		chunks.Commit(FormatFloat(f, chunks.Reserve(NUMBER_FORMAT_MAX_REAL_CHARS)));
+	}
+
+	void WriteReal(double d) {
+		chunks.Commit(FormatDouble(d, chunks.Reserve(NUMBER_FORMAT_MAX_REAL_CHARS)));
+	}
+
 private: 
-	Assimp::IOStream& out;
-	std::string indent, newline;
-	std::stringstream buff;
+	ChunkedStreamBuf chunks;
+	std::string indent, newline, space;
+	std::ostream buff;
 	bool first;
 
 	unsigned int flags;
+	BinaryBuffers* const buffers;
+	unsigned int threads;
+	unsigned int position_bits, normal_bits;
+	Assimp2JsonIndexEncoding index_encoding;
+	bool flat_indices;
 };
 
 
 void Write(JSONWriter& out, const aiVector3D& ai, bool is_elem = true) 
 {
-	out.StartArray(is_elem);
-	out.Element(ai.x);
-	out.Element(ai.y);
-	out.Element(ai.z);
-	out.EndArray();
+	out.StartArray(is_elem);
+	out.Element(ai.x);
+	out.Element(ai.y);
+	out.Element(ai.z);
+	out.EndArray();
+}
+
+void Write(JSONWriter& out, const aiQuaternion& ai, bool is_elem = true) 
+{
+	out.StartArray(is_elem);
+	out.Element(ai.w);
+	out.Element(ai.x);
+	out.Element(ai.y);
+	out.Element(ai.z);
+	out.EndArray();
+}
+
+void Write(JSONWriter& out, const aiColor3D& ai, bool is_elem = true) 
+{
+	out.StartArray(is_elem);
+	out.Element(ai.r);
+	out.Element(ai.g);
+	out.Element(ai.b);
+	out.EndArray();
+}
+
+void Write(JSONWriter& out, const aiMatrix4x4& ai, bool is_elem = true) 
+{
+	out.StartArray(is_elem);
+	for(unsigned int x = 0; x < 4; ++x) {
+		for(unsigned int y = 0; y < 4; ++y) {
+			out.Element(ai[x][y]);
+		}
+	}
+	out.EndArray();
+}
+
+void Write(JSONWriter& out, const aiBone& ai, bool is_elem = true)
+{
+	out.StartObj(is_elem);
+
+	out.Key("name");
+	out.SimpleValue(ai.mName);
+
+	out.Key("offsetmatrix");
+	Write(out,ai.mOffsetMatrix,false);
+
+	out.Key("weights");
+	out.StartArray();
+	for(unsigned int i = 0; i < ai.mNumWeights; ++i) {
+		out.StartArray(true);
+		out.Element(ai.mWeights[i].mVertexId);
+		out.Element(ai.mWeights[i].mWeight);
+		out.EndArray();
+	}
+	out.EndArray();
+	out.EndObj();
+}
+
+
+void Write(JSONWriter& out, const aiFace& ai, bool is_elem = true)
+{
+	out.StartArray(is_elem);
+	out.Elements(ai.mIndices, ai.mNumIndices);
+	out.EndArray();
+}
+
+
+	// run `count` tasks, each of which writes one or more array elements through the JSONWriter
+	// passed to it. Up to `threads` tasks run concurrently into separate buffers, which are written
+	// to `out` in task order, so the output is identical to running the tasks one after another.
+	// Must be called right after StartArray().
+template<typename Task>
+void WriteOrdered(JSONWriter& out, unsigned int count, unsigned int threads, const Task& task)
+{
+	if(threads <= 1 || count < 2) {
+		for(unsigned int n = 0; n < count; ++n) {
+			task(out,n);
+		}
+		return;
+	}
+
+	threads = std::min(threads, count);
+
+	// don't let workers get too far ahead of the output, so memory usage stays bounded
+	const unsigned int window = threads * 4;
+
+	std::vector<std::string> text(count);
+	std::vector<bool> done(count, false);
+	unsigned int next = 0, written = 0;
+	bool abort = false;
+	std::exception_ptr error;
+
+	std::mutex mutex;
+	std::condition_variable cond;
+
+	auto worker = [&]() {
+		std::unique_lock<std::mutex> lock(mutex);
+		for(;;) {
+			cond.wait(lock, [&]() { return abort || next >= count || next < written + window; });
+			if(abort || next >= count) {
+				return;
+			}
+
+			const unsigned int n = next++;
+			lock.unlock();
+
+			MemoryIOStream mem;
+			try {
+				JSONWriter part(mem, out, n == 0);
+				task(part,n);
+			}
+			catch(...) {
+				lock.lock();
+				if(!error) {
+					error = std::current_exception();
+				}
+				abort = true;
+				cond.notify_all();
+				return;
+			}
+
+			lock.lock();
+			text[n].swap(mem.data);
+			done[n] = true;
+			cond.notify_all();
+		}
+	};
+
+	// reserved up front so that no thread is left unowned if push_back() throws
+	std::vector<std::thread> pool;
+	pool.reserve(threads);
+	try {
+		for(unsigned int i = 0; i < threads; ++i) {
+			pool.push_back(std::thread(worker));
+		}
+
+		for(unsigned int n = 0; n < count; ++n) {
+			std::string chunk;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cond.wait(lock, [&]() { return abort || done[n]; });
+				if(abort) {
+					break;
+				}
+
+				chunk.swap(text[n]);
+				written = n + 1;
+				cond.notify_all();
+			}
+			out.ElementsRaw(chunk);
+		}
+	}
+	catch(...) {
+		// starting a thread or writing the output failed. The workers still have to be
+		// stopped and joined, destroying a joinable std::thread terminates the process.
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			abort = true;
+		}
+		cond.notify_all();
+		for(std::vector<std::thread>::iterator it = pool.begin(); it != pool.end(); ++it) {
+			(*it).join();
+		}
+		throw;
+	}
+
+	for(std::vector<std::thread>::iterator it = pool.begin(); it != pool.end(); ++it) {
+		(*it).join();
+	}
+
+	if(error) {
+		std::rethrow_exception(error);
+	}
+}
+
+	// write the items [0,count) of a large array in segments of a fixed number of
+	// items, which are formatted concurrently if the writer allows for it.
+template<typename WriteRange>
+void WriteSegmented(JSONWriter& out, unsigned int count, const WriteRange& write_range)
+{
+	const unsigned int segment = 1u << 14;
+	const unsigned int segments = count / segment + (count % segment ? 1 : 0);
+	WriteOrdered(out, segments, out.GetThreads(), [&](JSONWriter& w, unsigned int n) {
+		write_range(w, n * segment, std::min(count, (n + 1) * segment));
+	});
+}
+
+
+	// write the members of a reference to `count` items of `components` values of `type` each
+	// in a binary sidecar file into the current object
+void WriteRefMembers(JSONWriter& out, const BinaryBuffers::Ref& ref, unsigned int count, unsigned int components, const char* type)
+{
+	out.Key("buffer");
+	out.SimpleValue(ref.buffer);
+
+	out.Key("byteoffset");
+	out.SimpleValue(ref.byte_offset);
+
+	out.Key("count");
+	out.SimpleValue(count);
+
+	out.Key("components");
+	out.SimpleValue(components);
+
+	out.Key("type");
+	out.SimpleValue(type);
+}
+
+
+void Write(JSONWriter& out, const BinaryBuffers::Ref& ref, unsigned int count, unsigned int components, const char* type, bool is_elem = false)
+{
+	out.StartObj(is_elem);
+	WriteRefMembers(out, ref, count, components, type);
+	out.EndObj();
+}
+
+
+	// write `count` items of `components` floats each, which are `stride` floats apart
+void WriteFloats(JSONWriter& out, const float* data, unsigned int count, unsigned int components, unsigned int stride, bool is_elem = false)
+{
+	if(BinaryBuffers* const bin = out.GetBinaryBuffers()) {
+		const size_t bytes = static_cast<size_t>(count) * components * sizeof(float);
+		BinaryBuffers::Ref ref;
+		if(components == stride) {
+			ref = bin->Append(data, bytes);
+		}
+		else {
+			// gather into a small staging buffer
+			ref = bin->Begin(bytes);
+
+			float tmp[1024 * 3];
+			unsigned int n = 0;
+			for(unsigned int i = 0; i < count; ++i) {
+				for(unsigned int c = 0; c < components; ++c) {
+					tmp[n++] = data[i * stride + c];
+				}
+				if(n + components > sizeof tmp / sizeof tmp[0]) {
+					bin->Write(tmp, n * sizeof(float));
+					n = 0;
+				}
+			}
+			bin->Write(tmp, n * sizeof(float));
+		}
+
+		Write(out, ref, count, components, "\"float32\"", is_elem);
+		return;
+	}
+
+	out.StartArray(is_elem);
+	WriteSegmented(out, count, [=](JSONWriter& w, unsigned int begin, unsigned int end) {
+		for(unsigned int i = begin; i < end; ++i) {
+			for(unsigned int c = 0; c < components; ++c) {
+				w.Element(data[i * stride + c]);
+			}
+		}
+	});
+	out.EndArray();
+}
+
+
+void WriteFloats(JSONWriter& out, const aiVector3D* data, unsigned int count, unsigned int components = 3, bool is_elem = false)
+{
+	WriteFloats(out, &data->x, count, components, 3, is_elem);
+}
+
+
+	// name of the smallest integer type which holds `bits` bit values
+const char* IntegerType(unsigned int bits, bool is_signed)
+{
+	if(bits <= 8) {
+		return is_signed ? "\"int8\"" : "\"uint8\"";
+	}
+	if(bits <= 16) {
+		return is_signed ? "\"int16\"" : "\"uint16\"";
+	}
+	return is_signed ? "\"int32\"" : "\"uint32\"";
+}
+
+
+	// append `count` integers to the current block of `bin` as `Storage`. Signed values are
+	// two's complement, so they keep their bits when narrowed to unsigned types.
+template<typename Storage, typename Int>
+void WriteNarrowed(BinaryBuffers& bin, const Int* values, unsigned int count)
+{
+	Storage tmp[1024 * 4];
+	for(unsigned int ofs = 0; ofs < count; ofs += sizeof tmp / sizeof tmp[0]) {
+		const unsigned int n = std::min(count - ofs, static_cast<unsigned int>(sizeof tmp / sizeof tmp[0]));
+		for(unsigned int i = 0; i < n; ++i) {
+			tmp[i] = static_cast<Storage>(values[ofs + i]);
+		}
+		bin.Write(tmp, n * sizeof(Storage), sizeof(Storage));
+	}
+}
+
+
+	// write `count` items of up to 4 `components` integers of `bits` bits each, which `quantize(i, item)`
+	// stores to item[0..components) for item i, as the "count", "components", "type" and "data" members
+	// of the current object. With binary sidecar files, "buffer" and "byteoffset" refer to the data instead.
+template<typename Int, typename Quantize>
+void WriteIntegers(JSONWriter& out, unsigned int count, unsigned int components, unsigned int bits, const Quantize& quantize)
+{
+	const char* const type = IntegerType(bits, std::numeric_limits<Int>::is_signed);
+
+	if(BinaryBuffers* const bin = out.GetBinaryBuffers()) {
+		const size_t width = bits <= 8 ? 1 : bits <= 16 ? 2 : 4;
+		const size_t bytes = static_cast<size_t>(count) * components * width;
+
+		// pad the block so the blocks after it stay aligned for typed arrays
+		const size_t padded = (bytes + 3) & ~static_cast<size_t>(3);
+		const BinaryBuffers::Ref ref = bin->Begin(padded);
+
+		Int tmp[1024 * 4];
+		unsigned int n = 0;
+		for(unsigned int i = 0; i <= count; ++i) {
+			if(i == count || n + components > sizeof tmp / sizeof tmp[0]) {
+				if(width == 1) {
+					WriteNarrowed<uint8_t>(*bin, tmp, n);
+				}
+				else if(width == 2) {
+					WriteNarrowed<uint16_t>(*bin, tmp, n);
+				}
+				else {
+					WriteNarrowed<uint32_t>(*bin, tmp, n);
+				}
+				n = 0;
+			}
+			if(i < count) {
+				quantize(i, tmp + n);
+				n += components;
+			}
+		}
+
+		const char zeros[4] = {};
+		bin->Write(zeros, padded - bytes, 1);
+
+		WriteRefMembers(out, ref, count, components, type);
+		return;
+	}
+
+	out.Key("count");
+	out.SimpleValue(count);
+
+	out.Key("components");
+	out.SimpleValue(components);
+
+	out.Key("type");
+	out.SimpleValue(type);
+
+	out.Key("data");
+	out.StartArray();
+	WriteSegmented(out, count, [=](JSONWriter& w, unsigned int begin, unsigned int end) {
+		std::vector<Int> values(static_cast<size_t>(end - begin) * components);
+		for(unsigned int i = begin; i < end; ++i) {
+			quantize(i, &values[(i - begin) * components]);
+		}
+		w.Elements(&values[0], values.size());
+	});
+	out.EndArray();
+}
+
+
+	// `v` rounded to the nearest integer in [lo, hi], NaN gives `lo`
+inline double QuantizeRound(double v, double lo, double hi)
+{
+	return !(v > lo) ? lo : v >= hi ? hi : floor(v + 0.5);
+}
+
+
+	// write up to 4 `components` of `count` items, which are `stride` floats apart, as unsigned
+	// integers of `bits` bits spread over the range of each component. The range is written as
+	// "min" and "max", a value decodes as min + q * (max - min) / (2^bits - 1).
+void WriteQuantizedFloats(JSONWriter& out, const float* data, unsigned int count, unsigned int components, unsigned int stride,
+	unsigned int bits, bool is_elem = false)
+{
+	// non-finite values don't count towards the range, they are quantized to its bounds
+	float lo[4], hi[4];
+	for(unsigned int c = 0; c < components; ++c) {
+		lo[c] = std::numeric_limits<float>::max();
+		hi[c] = -std::numeric_limits<float>::max();
+		for(unsigned int i = 0; i < count; ++i) {
+			const float v = data[i * stride + c];
+			if(v - v == 0.f) {
+				lo[c] = std::min(lo[c], v);
+				hi[c] = std::max(hi[c], v);
+			}
+		}
+		if(lo[c] > hi[c]) {
+			lo[c] = hi[c] = 0.f;
+		}
+	}
+
+	const double levels = static_cast<double>((static_cast<uint64_t>(1) << bits) - 1);
+	double scale[4];
+	for(unsigned int c = 0; c < components; ++c) {
+		scale[c] = hi[c] > lo[c] ? levels / (static_cast<double>(hi[c]) - lo[c]) : 0.;
+	}
+
+	out.StartObj(is_elem);
+
+	out.Key("encoding");
+	out.SimpleValue("\"quantized\"");
+
+	out.Key("bits");
+	out.SimpleValue(bits);
+
+	out.Key("min");
+	out.StartArray();
+	for(unsigned int c = 0; c < components; ++c) {
+		out.Element(lo[c]);
+	}
+	out.EndArray();
+
+	out.Key("max");
+	out.StartArray();
+	for(unsigned int c = 0; c < components; ++c) {
+		out.Element(hi[c]);
+	}
+	out.EndArray();
+
+	WriteIntegers<unsigned int>(out, count, components, bits, [=](unsigned int i, unsigned int* item) {
+		for(unsigned int c = 0; c < components; ++c) {
+			const double v = data[i * stride + c];
+			item[c] = static_cast<unsigned int>(QuantizeRound((v - lo[c]) * scale[c], 0., levels));
+		}
+	});
+
+	out.EndObj();
+}
+
+
+	// write up to 4 `components` of `count` items, which are `stride` floats apart and expected to lie
+	// in [0,1], as unsigned integers of `bits` bits. A value decodes as q / (2^bits - 1).
+void WriteNormalizedFloats(JSONWriter& out, const float* data, unsigned int count, unsigned int components, unsigned int stride,
+	unsigned int bits, bool is_elem = false)
+{
+	out.StartObj(is_elem);
+
+	out.Key("encoding");
+	out.SimpleValue("\"normalized\"");
+
+	out.Key("bits");
+	out.SimpleValue(bits);
+
+	const double levels = static_cast<double>((static_cast<uint64_t>(1) << bits) - 1);
+	WriteIntegers<unsigned int>(out, count, components, bits, [=](unsigned int i, unsigned int* item) {
+		for(unsigned int c = 0; c < components; ++c) {
+			item[c] = static_cast<unsigned int>(QuantizeRound(data[i * stride + c] * levels, 0., levels));
+		}
+	});
+
+	out.EndObj();
+}
+
+
+	// write `count` directions in octahedral encoding as two signed integers of `bits` bits each.
+	// With s = 2^(bits-1) - 1, (x, y) = (q0 / s, q1 / s) and z = 1 - |x| - |y|. If z < 0, x and y
+	// are replaced by (1 - |y|) * sign(x) and (1 - |x|) * sign(y). The result is then normalized.
+void WriteOctahedral(JSONWriter& out, const aiVector3D* data, unsigned int count, unsigned int bits)
+{
+	out.StartObj();
+
+	out.Key("encoding");
+	out.SimpleValue("\"octahedral\"");
+
+	out.Key("bits");
+	out.SimpleValue(bits);
+
+	const double levels = static_cast<double>((1u << (bits - 1)) - 1);
+	WriteIntegers<int>(out, count, 2, bits, [=](unsigned int i, int* item) {
+		const aiVector3D& v = data[i];
+
+		// project onto the octahedron and fold its lower half over the upper one. Zero
+		// length and non-finite vectors end up as (0, 0).
+		const double l1 = fabs(v.x) + fabs(v.y) + fabs(v.z);
+		double x = 0., y = 0.;
+		if(l1 > 0. && l1 - l1 == 0.) {
+			x = v.x / l1;
+			y = v.y / l1;
+			if(v.z < 0.f) {
+				const double fx = (1. - fabs(y)) * (x < 0. ? -1. : 1.);
+				y = (1. - fabs(x)) * (y < 0. ? -1. : 1.);
+				x = fx;
+			}
+		}
+		item[0] = static_cast<int>(QuantizeRound(x * levels, -levels, levels));
+		item[1] = static_cast<int>(QuantizeRound(y * levels, -levels, levels));
+	});
+
+	out.EndObj();
+}
+
+
+	// vertex attributes are quantized if the writer is set up for it
+void WritePositions(JSONWriter& out, const aiVector3D* data, unsigned int count)
+{
+	if(out.IsQuantizing()) {
+		WriteQuantizedFloats(out, &data->x, count, 3, 3, out.GetPositionBits());
+		return;
+	}
+	WriteFloats(out, data, count);
+}
+
+
+void WriteDirections(JSONWriter& out, const aiVector3D* data, unsigned int count)
+{
+	if(out.IsQuantizing()) {
+		WriteOctahedral(out, data, count, out.GetNormalBits());
+		return;
+	}
+	WriteFloats(out, data, count);
 }
 
-void Write(JSONWriter& out, const aiQuaternion& ai, bool is_elem = true) 
+
+void WriteTextureCoords(JSONWriter& out, const aiVector3D* data, unsigned int count, unsigned int components)
 {
-	out.StartArray(is_elem);
-	out.Element(ai.w);
-	out.Element(ai.x);
-	out.Element(ai.y);
-	out.Element(ai.z);
-	out.EndArray();
+	if(out.IsQuantizing()) {
+		WriteQuantizedFloats(out, &data->x, count, components, 3, QUANTIZED_TEXCOORD_BITS, true);
+		return;
+	}
+	WriteFloats(out, data, count, components, true);
 }
 
-void Write(JSONWriter& out, const aiColor3D& ai, bool is_elem = true) 
+
+void WriteColors(JSONWriter& out, const aiColor4D* data, unsigned int count)
 {
-	out.StartArray(is_elem);
-	out.Element(ai.r);
-	out.Element(ai.g);
-	out.Element(ai.b);
-	out.EndArray();
+	if(out.IsQuantizing()) {
+		WriteNormalizedFloats(out, &data->r, count, 4, 4, QUANTIZED_COLOR_BITS, true);
+		return;
+	}
+	WriteFloats(out, &data->r, count, 4, 4, true);
 }
 
-void Write(JSONWriter& out, const aiMatrix4x4& ai, bool is_elem = true) 
+
+void WriteFaces(JSONWriter& out, const aiFace* faces, unsigned int count)
 {
-	out.StartArray(is_elem);
-	for(unsigned int x = 0; x < 4; ++x) {
-		for(unsigned int y = 0; y < 4; ++y) {
-			out.Element(ai[x][y]);
+	BinaryBuffers* const bin = out.GetBinaryBuffers();
+
+	// a flat index block needs all faces to have the same number of indices,
+	// meshes with mixed polygons are written as nested arrays.
+	bool uniform = count > 0;
+	for(unsigned int n = 1; n < count && uniform; ++n) {
+		uniform = faces[n].mNumIndices == faces[0].mNumIndices;
+	}
+
+	if(bin && uniform) {
+		const unsigned int components = faces[0].mNumIndices;
+		const BinaryBuffers::Ref ref = bin->Begin(static_cast<size_t>(count) * components * sizeof(unsigned int));
+
+		// small faces are gathered so that the sidecar file isn't written to per face,
+		// polygons which don't fit the staging buffer go straight to the file
+		unsigned int tmp[1024 * 3];
+		unsigned int n = 0;
+		for(unsigned int i = 0; i < count; ++i) {
+			if(components > sizeof tmp / sizeof tmp[0]) {
+				bin->Write(faces[i].mIndices, components * sizeof(unsigned int));
+				continue;
+			}
+			if(n + components > sizeof tmp / sizeof tmp[0]) {
+				bin->Write(tmp, n * sizeof(unsigned int));
+				n = 0;
+			}
+			memcpy(tmp + n, faces[i].mIndices, components * sizeof(unsigned int));
+			n += components;
 		}
+		bin->Write(tmp, n * sizeof(unsigned int));
+
+		Write(out, ref, count, components, "\"uint32\"");
+		return;
 	}
+
+	out.StartArray();
+	WriteSegmented(out, count, [=](JSONWriter& w, unsigned int begin, unsigned int end) {
+		for(unsigned int n = begin; n < end; ++n) {
+			Write(w, faces[n]);
+		}
+	});
 	out.EndArray();
 }
 
-void Write(JSONWriter& out, const aiBone& ai, bool is_elem = true)
-{
-	out.StartObj(is_elem);
 
-	out.Key("name");
-	out.SimpleValue(ai.mName);
+	// true if all faces are triangles
+bool IsTriangleMesh(const aiFace* faces, unsigned int count)
+{
+	for(unsigned int n = 0; n < count; ++n) {
+		if(faces[n].mNumIndices != 3) {
+			return false;
+		}
+	}
+	return count > 0;
+}
 
-	out.Key("offsetmatrix");
-	Write(out,ai.mOffsetMatrix,false);
 
-	out.Key("weights");
+	// write the indices of `count` triangles as one flat array
+void WriteFlatIndices(JSONWriter& out, const aiFace* faces, unsigned int count)
+{
 	out.StartArray();
-	for(unsigned int i = 0; i < ai.mNumWeights; ++i) {
-		out.StartArray(true);
-		out.Element(ai.mWeights[i].mVertexId);
-		out.Element(ai.mWeights[i].mWeight);
-		out.EndArray();
-	}
+	WriteSegmented(out, count, [=](JSONWriter& w, unsigned int begin, unsigned int end) {
+		std::vector<unsigned int> indices(static_cast<size_t>(end - begin) * 3);
+		for(unsigned int n = begin; n < end; ++n) {
+			memcpy(&indices[(n - begin) * 3], faces[n].mIndices, 3 * sizeof(unsigned int));
+		}
+		w.Elements(&indices[0], indices.size());
+	});
 	out.EndArray();
-	out.EndObj();
 }
 
 
-void Write(JSONWriter& out, const aiFace& ai, bool is_elem = true)
+	// write the indices of `count` triangles as one flat stream of integers, each of which encodes
+	// an index relative to the ones before it. See ASSIMP2JSON_CONFIG_INDEX_ENCODING for decoding.
+void WriteEncodedIndices(JSONWriter& out, const aiFace* faces, unsigned int count, Assimp2JsonIndexEncoding encoding)
 {
-	out.StartArray(is_elem);
-	for(unsigned int i = 0; i < ai.mNumIndices; ++i) {
-		out.Element(ai.mIndices[i]);
+	const bool watermark = encoding == Assimp2JsonIndexEncoding_Watermark;
+
+	// the high watermark at the start of each block of faces, so that segments can be
+	// encoded independently of each other
+	const unsigned int block = 1u << 12;
+	std::vector<unsigned int> block_next;
+	if(watermark) {
+		unsigned int next = 0;
+		for(unsigned int n = 0; n < count; ++n) {
+			if(n % block == 0) {
+				block_next.push_back(next);
+			}
+			for(unsigned int i = 0; i < 3; ++i) {
+				next = std::max(next, faces[n].mIndices[i] + 1);
+			}
+		}
 	}
+
+	out.StartObj();
+
+	out.Key("encoding");
+	out.SimpleValue(watermark ? "\"watermark\"" : "\"delta\"");
+
+	out.Key("count");
+	out.SimpleValue(count);
+
+	out.Key("components");
+	out.SimpleValue(3u);
+
+	out.Key("data");
+	out.StartArray();
+	WriteSegmented(out, count, [&](JSONWriter& w, unsigned int begin, unsigned int end) {
+		// state of the encoder after the faces before `begin`
+		unsigned int prev = begin ? faces[begin - 1].mIndices[2] : 0;
+		unsigned int next = 0;
+		if(watermark) {
+			next = block_next[begin / block];
+			for(unsigned int n = begin / block * block; n < begin; ++n) {
+				for(unsigned int i = 0; i < 3; ++i) {
+					next = std::max(next, faces[n].mIndices[i] + 1);
+				}
+			}
+		}
+
+		// unsigned differences wrap around, which turns them into the right signed values
+		std::vector<int> codes(static_cast<size_t>(end - begin) * 3);
+		for(unsigned int n = begin, c = 0; n < end; ++n) {
+			for(unsigned int i = 0; i < 3; ++i, ++c) {
+				const unsigned int index = faces[n].mIndices[i];
+				if(watermark) {
+					codes[c] = static_cast<int>(next - index);
+					next = std::max(next, index + 1);
+				}
+				else {
+					codes[c] = static_cast<int>(index - prev);
+					prev = index;
+				}
+			}
+		}
+		w.Elements(&codes[0], codes.size());
+	});
 	out.EndArray();
+
+	out.EndObj();
 }
 
 
@@ -344,51 +1465,25 @@ void Write(JSONWriter& out, const aiMesh& ai, bool is_elem = true)
 	out.SimpleValue(ai.mPrimitiveTypes);
 
 	out.Key("vertices");
-	out.StartArray();
-	for(unsigned int i = 0; i < ai.mNumVertices; ++i) {
-		out.Element(ai.mVertices[i].x);
-		out.Element(ai.mVertices[i].y);
-		out.Element(ai.mVertices[i].z);
-	}
-	out.EndArray();
+	WritePositions(out, ai.mVertices, ai.mNumVertices);
 
 	if(ai.HasNormals()) {
 		out.Key("normals");
-		out.StartArray();
-		for(unsigned int i = 0; i < ai.mNumVertices; ++i) {
-			out.Element(ai.mNormals[i].x);
-			out.Element(ai.mNormals[i].y);
-			out.Element(ai.mNormals[i].z);
-		}
-		out.EndArray();
+		WriteDirections(out, ai.mNormals, ai.mNumVertices);
 	}
 
 	if(ai.HasTangentsAndBitangents()) {
 		out.Key("tangents");
-		out.StartArray();
-		for(unsigned int i = 0; i < ai.mNumVertices; ++i) {
-			out.Element(ai.mTangents[i].x);
-			out.Element(ai.mTangents[i].y);
-			out.Element(ai.mTangents[i].z);
-		}
-		out.EndArray();
+		WriteDirections(out, ai.mTangents, ai.mNumVertices);
 
 		out.Key("bitangents");
-		out.StartArray();
-		for(unsigned int i = 0; i < ai.mNumVertices; ++i) {
-			out.Element(ai.mBitangents[i].x);
-			out.Element(ai.mBitangents[i].y);
-			out.Element(ai.mBitangents[i].z);
-		}
-		out.EndArray();
+		WriteDirections(out, ai.mBitangents, ai.mNumVertices);
 	}
 
 	if(ai.GetNumUVChannels()) {
 		out.Key("numuvcomponents");
 		out.StartArray();
-		for(unsigned int n = 0; n < ai.GetNumUVChannels(); ++n) {
-			out.Element(ai.mNumUVComponents[n]);
-		}
+		out.Elements(ai.mNumUVComponents, ai.GetNumUVChannels());
 		out.EndArray();
 
 		out.Key("texturecoords");
@@ -396,14 +1491,7 @@ void Write(JSONWriter& out, const aiMesh& ai, bool is_elem = true)
 		for(unsigned int n = 0; n < ai.GetNumUVChannels(); ++n) {
 
 			const unsigned int numc = ai.mNumUVComponents[n] ? ai.mNumUVComponents[n] : 2;
-			
-			out.StartArray(true);
-			for(unsigned int i = 0; i < ai.mNumVertices; ++i) {
-				for(unsigned int c = 0; c < numc; ++c) {
-					out.Element(ai.mTextureCoords[n][i][c]);
-				}
-			}
-			out.EndArray();
+			WriteTextureCoords(out, ai.mTextureCoords[n], ai.mNumVertices, numc);
 		}
 		out.EndArray();
 	}
@@ -412,15 +1500,7 @@ void Write(JSONWriter& out, const aiMesh& ai, bool is_elem = true)
 		out.Key("colors");
 		out.StartArray();
 		for(unsigned int n = 0; n < ai.GetNumColorChannels(); ++n) {
-
-			out.StartArray(true);
-			for(unsigned int i = 0; i < ai.mNumVertices; ++i) {
-				out.Element(ai.mColors[n][i].r);
-				out.Element(ai.mColors[n][i].g);
-				out.Element(ai.mColors[n][i].b);
-				out.Element(ai.mColors[n][i].a);
-			}
-			out.EndArray();
+			WriteColors(out, ai.mColors[n], ai.mNumVertices);
 		}
 		out.EndArray();
 	}
@@ -435,12 +1515,21 @@ void Write(JSONWriter& out, const aiMesh& ai, bool is_elem = true)
 	}
 
 
-	out.Key("faces");
-	out.StartArray();
-	for(unsigned int n = 0; n < ai.mNumFaces; ++n) {
-		Write(out, ai.mFaces[n]);
+	// the faces are checked rather than mPrimitiveTypes, which is only set by aiProcess_SortByPType.
+	// Binary sidecar files take the indices of triangle meshes as they are.
+	if(out.GetFlatIndices() && !out.GetBinaryBuffers() && IsTriangleMesh(ai.mFaces, ai.mNumFaces)) {
+		out.Key("indices");
+		if(out.GetIndexEncoding() != Assimp2JsonIndexEncoding_None) {
+			WriteEncodedIndices(out, ai.mFaces, ai.mNumFaces, out.GetIndexEncoding());
+		}
+		else {
+			WriteFlatIndices(out, ai.mFaces, ai.mNumFaces);
+		}
+	}
+	else {
+		out.Key("faces");
+		WriteFaces(out, ai.mFaces, ai.mNumFaces);
 	}
-	out.EndArray();
 
 	out.EndObj();
 }
@@ -459,9 +1548,7 @@ void Write(JSONWriter& out, const aiNode& ai, bool is_elem = true)
 	if(ai.mNumMeshes) {
 		out.Key("meshes");
 		out.StartArray();
-		for(unsigned int n = 0; n < ai.mNumMeshes; ++n) {
-			out.Element(ai.mMeshes[n]);
-		}
+		out.Elements(ai.mMeshes, ai.mNumMeshes);
 		out.EndArray();
 	}
 
@@ -571,11 +1658,9 @@ void Write(JSONWriter& out, const aiTexture& ai, bool is_elem = true)
 			out.StartArray(true);
 			for(unsigned int x = 0; x < ai.mWidth; ++x) {
 				const aiTexel& tx = ai.pcData[y*ai.mWidth+x];
+				const unsigned int rgba[] = {tx.r, tx.g, tx.b, tx.a};
 				out.StartArray(true);
-				out.Element(static_cast<unsigned int>(tx.r));
-				out.Element(static_cast<unsigned int>(tx.g));
-				out.Element(static_cast<unsigned int>(tx.b));
-				out.Element(static_cast<unsigned int>(tx.a));
+				out.Elements(rgba, 4);
 				out.EndArray();
 			}
 			out.EndArray();
@@ -740,6 +1825,23 @@ void Write(JSONWriter& out, const aiCamera& ai, bool is_elem = true)
 	out.EndObj();
 }
 
+void Write(JSONWriter& out, const BinaryBuffers& ai)
+{
+	out.StartArray();
+	for(std::vector<BinaryBuffers::FileInfo>::const_iterator it = ai.GetFiles().begin(); it != ai.GetFiles().end(); ++it) {
+		out.StartObj(true);
+
+		out.Key("uri");
+		out.SimpleValue(aiString((*it).uri));
+
+		out.Key("bytelength");
+		out.SimpleValue((*it).byte_length);
+
+		out.EndObj();
+	}
+	out.EndArray();
+}
+
 void WriteFormatInfo(JSONWriter& out)
 {
 	out.StartObj();
@@ -747,9 +1849,61 @@ void WriteFormatInfo(JSONWriter& out)
 	out.SimpleValue("\"assimp2json\"");
 	out.Key("version");
 	out.SimpleValue(CURRENT_FORMAT_VERSION);
+
+	// tells readers up front that triangle meshes may carry "indices" instead of "faces",
+	// and in which form
+	if(out.GetFlatIndices() && !out.GetBinaryBuffers()) {
+		out.Key("indices");
+		switch(out.GetIndexEncoding()) {
+			case Assimp2JsonIndexEncoding_Delta:
+				out.SimpleValue("\"delta\"");
+				break;
+			case Assimp2JsonIndexEncoding_Watermark:
+				out.SimpleValue("\"watermark\"");
+				break;
+			default:
+				out.SimpleValue("\"flat\"");
+		}
+	}
 	out.EndObj();
 }
 
+	// records the time spent on and the number of characters written for a top-level section
+	// of the document in the current ConversionStats, if any
+class SectionStats
+{
+
+public:
+
+	SectionStats(const JSONWriter& out, const char* name)
+		: phase(name)
+		, out(out)
+		, start(out.Tell())
+	{}
+
+	~SectionStats() {
+		phase.SetBytes(out.Tell() - start);
+	}
+
+private:
+
+	StatsPhase phase;
+	const JSONWriter& out;
+	const size_t start;
+};
+
+
+	// write the elements of an array of scene objects, concurrently if the writer allows for it
+template<typename T>
+void WriteElements(JSONWriter& out, T* const* items, unsigned int count)
+{
+	// data in binary sidecar files needs to be written in document order
+	const unsigned int threads = out.GetBinaryBuffers() ? 1 : out.GetThreads();
+	WriteOrdered(out, count, threads, [=](JSONWriter& w, unsigned int n) {
+		Write(w,*items[n]);
+	});
+}
+
 void Write(JSONWriter& out, const aiScene& ai)
 {
 	out.StartObj();
@@ -758,35 +1912,35 @@ void Write(JSONWriter& out, const aiScene& ai)
 	WriteFormatInfo(out);
 
 	out.Key("rootnode");
-	Write(out,*ai.mRootNode, false);
+	{
+		SectionStats stats(out, "export.write.rootnode");
+		Write(out,*ai.mRootNode, false);
+	}
 
 	out.Key("flags");
 	out.SimpleValue(ai.mFlags);
 
 	if(ai.HasMeshes()) {
+		SectionStats stats(out, "export.write.meshes");
 		out.Key("meshes");
 		out.StartArray();
-		for(unsigned int n = 0; n < ai.mNumMeshes; ++n) {
-			Write(out,*ai.mMeshes[n]);
-		}
+		WriteElements(out,ai.mMeshes,ai.mNumMeshes);
 		out.EndArray();
 	}
 
 	if(ai.HasMaterials()) {
+		SectionStats stats(out, "export.write.materials");
 		out.Key("materials");
 		out.StartArray();
-		for(unsigned int n = 0; n < ai.mNumMaterials; ++n) {
-			Write(out,*ai.mMaterials[n]);
-		}
+		WriteElements(out,ai.mMaterials,ai.mNumMaterials);
 		out.EndArray();
 	}
 
 	if(ai.HasAnimations()) {
+		SectionStats stats(out, "export.write.animations");
 		out.Key("animations");
 		out.StartArray();
-		for(unsigned int n = 0; n < ai.mNumAnimations; ++n) {
-			Write(out,*ai.mAnimations[n]);
-		}
+		WriteElements(out,ai.mAnimations,ai.mNumAnimations);
 		out.EndArray();
 	}
 
@@ -809,44 +1963,362 @@ void Write(JSONWriter& out, const aiScene& ai)
 	}
 
 	if(ai.HasTextures()) {
+		SectionStats stats(out, "export.write.textures");
 		out.Key("textures");
 		out.StartArray();
-		for(unsigned int n = 0; n < ai.mNumTextures; ++n) {
-			Write(out,*ai.mTextures[n]);
-		}
+		WriteElements(out,ai.mTextures,ai.mNumTextures);
 		out.EndArray();
 	}
+
+	// written last so the final file sizes are known
+	if(const BinaryBuffers* const bin = out.GetBinaryBuffers()) {
+		out.Key("buffers");
+		Write(out,*bin);
+	}
 	out.EndObj();
 }
 
 
-void Assimp2Json(const char* file, Assimp::IOSystem* io, const aiScene* scene, const Assimp::ExportProperties*) 
+// Get a copy of the scene which shares all data with the source scene except for its own
+// mesh list, so meshes can be replaced without modifying the source.
+aiScene* ShallowCopy(const aiScene* scene)
 {
-	boost::scoped_ptr<Assimp::IOStream> str(io->Open(file,"wt"));
-	if(!str) {
-		//throw Assimp::DeadlyExportError("could not open output file");
+	aiScene* const out = new aiScene();
+	out->mFlags = scene->mFlags;
+	out->mRootNode = scene->mRootNode;
+
+	out->mNumMeshes = scene->mNumMeshes;
+	out->mMeshes = new aiMesh*[scene->mNumMeshes]();
+	std::copy(scene->mMeshes, scene->mMeshes + scene->mNumMeshes, out->mMeshes);
+
+	out->mNumMaterials = scene->mNumMaterials;
+	out->mMaterials = scene->mMaterials;
+	out->mNumAnimations = scene->mNumAnimations;
+	out->mAnimations = scene->mAnimations;
+	out->mNumTextures = scene->mNumTextures;
+	out->mTextures = scene->mTextures;
+	out->mNumLights = scene->mNumLights;
+	out->mLights = scene->mLights;
+	out->mNumCameras = scene->mNumCameras;
+	out->mCameras = scene->mCameras;
+	return out;
+}
+
+// Free a scene obtained from ShallowCopy(), but only what it doesn't share with the source scene
+void FreeShallowCopy(aiScene* copy, const aiScene* scene)
+{
+	if(copy->mRootNode == scene->mRootNode) {
+		copy->mRootNode = NULL;
+	}
+
+	const std::set<const aiMesh*> shared(scene->mMeshes, scene->mMeshes + scene->mNumMeshes);
+	for(unsigned int n = 0; n < copy->mNumMeshes; ++n) {
+		if(shared.count(copy->mMeshes[n])) {
+			copy->mMeshes[n] = NULL;
+		}
+	}
+
+	copy->mNumMaterials = 0;
+	copy->mMaterials = NULL;
+	copy->mNumAnimations = 0;
+	copy->mAnimations = NULL;
+	copy->mNumTextures = 0;
+	copy->mTextures = NULL;
+	copy->mNumLights = 0;
+	copy->mLights = NULL;
+	copy->mNumCameras = 0;
+	copy->mCameras = NULL;
+	delete copy;
+}
+
+
+// Adapts an Assimp2JsonSink to the Assimp::IOStream interface the writer works on. Once
+// the sink fails, all further output is dropped.
+class SinkIOStream : public Assimp::IOStream
+{
+
+public:
+
+	explicit SinkIOStream(Assimp2JsonSink& sink)
+		: sink(sink)
+		, pos()
+		, failed()
+	{}
+
+public:
+
+	size_t Read(void*, size_t, size_t) {
+		return 0;
+	}
+
+	size_t Write(const void* pvBuffer, size_t pSize, size_t pCount) {
+		if(failed || !sink.Write(static_cast<const char*>(pvBuffer), pSize * pCount)) {
+			failed = true;
+			return 0;
+		}
+		pos += pSize * pCount;
+		return pCount;
+	}
+
+	aiReturn Seek(size_t, aiOrigin) {
+		return aiReturn_FAILURE;
+	}
+
+	size_t Tell() const {
+		return pos;
 	}
 
-	// get a copy of the scene so we can modify it
-	aiScene* scenecopy_tmp;
-	aiCopyScene(scene, &scenecopy_tmp);
+	size_t FileSize() const {
+		return pos;
+	}
+
+	void Flush() {
+	}
+
+private:
+	Assimp2JsonSink& sink;
+	size_t pos;
+	bool failed;
+};
+
+
+// Write `scene` to `str`. If `io` and `file` are given, the binary sidecar files are
+// created through `io` next to `file`. options.compression must not be _Auto. Returns
+// false if writing to `str` failed.
+bool ExportScene(Assimp::IOStream& str, Assimp::IOSystem* io, const char* file, const aiScene* scene, const Assimp2JsonOptions& options)
+{
+	// options which come straight from the caller are checked before any work is done
+	if(options.quantize && (options.position_bits < 1 || options.position_bits > 24 ||
+		options.normal_bits < 2 || options.normal_bits > 16)) {
+		throw std::runtime_error("quantized positions take 1 to 24 bits, normals 2 to 16 bits");
+	}
+	if(options.split_limit && options.split_limit < 3) {
+		throw std::runtime_error("the split limit must be 0 or at least 3 vertices");
+	}
+
+	// get a shallow copy of the scene so we can replace meshes without touching the input. Only
+	// meshes which actually need splitting (and the node hierarchy, then) are ever duplicated.
+	aiScene* scenecopy_tmp = NULL;
+	if(options.split_limit) {
+		StatsPhase phase("export.copy");
+		scenecopy_tmp = ShallowCopy(scene);
+	}
 
+	bool ok;
 	try {
-		// split meshes so they fit into a 16 bit index buffer
-		MeshSplitter splitter;
-		splitter.SetLimit(1 << 16);
-		splitter.Execute(scenecopy_tmp);
+		// meshes can be split and scene objects and large attribute arrays be formatted
+		// concurrently, 0 means one thread per core
+		const unsigned int threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+
+		if(scenecopy_tmp) {
+			StatsPhase phase("export.split");
+
+			MeshSplitter splitter;
+			splitter.SetLimit(options.split_limit);
+			splitter.SetThreads(threads);
+			splitter.SetLocalityAware(options.split_locality);
+			splitter.SetOptimizeVertexCache(options.optimize_vertex_cache);
+			splitter.ExecuteShared(scenecopy_tmp);
+
+			if(ConversionStats* const stats = ConversionStats::GetCurrent()) {
+				const MeshSplitter::Stats& split = splitter.GetStats();
+				stats->AddCounter("split.meshes", split.split_meshes);
+				stats->AddCounter("split.parts", split.parts);
+				stats->AddCounter("split.duplication", split.GetDuplicationRatio());
+				stats->AddCounter("split.acmr_before", split.GetACMRBefore());
+				stats->AddCounter("split.acmr_after", split.GetACMRAfter());
+			}
+		}
 
 		// XXX Flag_WriteSpecialFloats is turned on by default, right now we don't have a configuration interface for exporters
-		JSONWriter s(*str,JSONWriter::Flag_WriteSpecialFloats);
-		Write(s,*scenecopy_tmp);
+		unsigned int flags = JSONWriter::Flag_WriteSpecialFloats;
+		if(options.compact) {
+			flags |= JSONWriter::Flag_Compact;
+		}
 
+		// large numeric arrays go to binary sidecar files if requested and
+		// if we can create them, otherwise we fall back to plain JSON.
+		boost::scoped_ptr<BinaryBuffers> buffers;
+		if(options.binary_buffers && io && file) {
+			buffers.reset(new BinaryBuffers(*io, file));
+			if(!buffers->IsOpen()) {
+				buffers.reset();
+			}
+		}
+
+		// the document is compressed as the writer hands over its chunks
+		boost::scoped_ptr<CompressedIOStream> compressed;
+		if(options.compression != Assimp2JsonCompression_None) {
+			std::string error;
+			compressed.reset(CompressedIOStream::Create(str, options.compression, options.compression_level, threads, &error));
+			if(!compressed) {
+				throw std::runtime_error(error);
+			}
+		}
+
+		JSONWriter s(compressed ? *compressed : str,flags,buffers.get());
+		s.SetThreads(threads);
+		if(options.quantize) {
+			s.SetQuantization(options.position_bits, options.normal_bits);
+		}
+		s.SetIndexEncoding(options.index_encoding);
+		s.SetFlatIndices(options.flat_indices);
+		{
+			SectionStats stats(s, "export.write");
+			Write(s,scenecopy_tmp ? *scenecopy_tmp : *scene);
+		}
+
+		StatsPhase phase("export.flush");
+		s.Flush();
+		ok = !s.Failed();
+		if(compressed) {
+			ok = compressed->Finish() && ok;
+		}
+		str.Flush();
 	}
 	catch(...) {
-		aiFreeScene(scenecopy_tmp);
+		if(scenecopy_tmp) {
+			FreeShallowCopy(scenecopy_tmp, scene);
+		}
 		throw;
 	}
-	aiFreeScene(scenecopy_tmp);
+	if(scenecopy_tmp) {
+		FreeShallowCopy(scenecopy_tmp, scene);
+	}
+	return ok;
+}
+
+
+void Assimp2Json(const char* file, Assimp::IOSystem* io, const aiScene* scene, const Assimp::ExportProperties* props) 
+{
+	// exporters report errors by throwing. Exporter::Export() turns the exception into its
+	// return value and GetErrorString() in assimp versions which catch it, otherwise it
+	// reaches the caller.
+	std::string error;
+	if(!Assimp2JsonWriteFile(scene, file, Assimp2JsonOptions::FromProperties(props), &error, io)) {
+		throw std::runtime_error(error);
+	}
 }
 
 } // 
+
+
+// ------------------------------------------------------------------------------------------------
+Assimp2JsonOptions Assimp2JsonOptions :: FromProperties(const Assimp::ExportProperties* props)
+{
+	Assimp2JsonOptions options;
+	if(props) {
+		options.compact = props->GetPropertyBool(ASSIMP2JSON_CONFIG_COMPACT, false);
+		options.binary_buffers = props->GetPropertyBool(ASSIMP2JSON_CONFIG_BINARY_BUFFERS, false);
+		options.threads = static_cast<unsigned int>(std::max(0, props->GetPropertyInteger(ASSIMP2JSON_CONFIG_THREADS, 1)));
+		options.split_limit = static_cast<unsigned int>(std::max(0, props->GetPropertyInteger(ASSIMP2JSON_CONFIG_SPLIT_LIMIT, 1 << 16)));
+		if(options.split_limit && options.split_limit < 3) {
+			// too small for a triangle, keep the default like for any other invalid value
+			options.split_limit = 1 << 16;
+		}
+		options.split_locality = props->GetPropertyBool(ASSIMP2JSON_CONFIG_SPLIT_LOCALITY, false);
+		options.optimize_vertex_cache = props->GetPropertyBool(ASSIMP2JSON_CONFIG_OPTIMIZE_VERTEX_CACHE, false);
+		options.compression_level = props->GetPropertyInteger(ASSIMP2JSON_CONFIG_COMPRESSION_LEVEL, 0);
+		options.quantize = props->GetPropertyBool(ASSIMP2JSON_CONFIG_QUANTIZE, false);
+		options.position_bits = static_cast<unsigned int>(std::max(0, props->GetPropertyInteger(ASSIMP2JSON_CONFIG_QUANTIZE_POSITION_BITS, 16)));
+		options.normal_bits = static_cast<unsigned int>(std::max(0, props->GetPropertyInteger(ASSIMP2JSON_CONFIG_QUANTIZE_NORMAL_BITS, 12)));
+		if(options.position_bits < 1 || options.position_bits > 24) {
+			options.position_bits = 16;
+		}
+		if(options.normal_bits < 2 || options.normal_bits > 16) {
+			options.normal_bits = 12;
+		}
+
+		options.flat_indices = props->GetPropertyBool(ASSIMP2JSON_CONFIG_FLAT_INDICES, false);
+
+		const std::string index_encoding = props->GetPropertyString(ASSIMP2JSON_CONFIG_INDEX_ENCODING, "none");
+		if(index_encoding == "delta") {
+			options.index_encoding = Assimp2JsonIndexEncoding_Delta;
+		}
+		else if(index_encoding == "watermark") {
+			options.index_encoding = Assimp2JsonIndexEncoding_Watermark;
+		}
+	}
+	return options;
+}
+
+// ------------------------------------------------------------------------------------------------
+bool Assimp2JsonFileDescriptorSink :: Write(const char* data, size_t size)
+{
+	FileDescriptorIOStream stream(fd);
+	return stream.Write(data, 1, size) == size;
+}
+
+// ------------------------------------------------------------------------------------------------
+bool Assimp2JsonWrite(const aiScene* scene, Assimp2JsonSink& sink, const Assimp2JsonOptions& options, std::string* error)
+{
+	Assimp2JsonOptions resolved = options;
+	if(resolved.compression == Assimp2JsonCompression_Auto) {
+		resolved.compression = Assimp2JsonCompression_None;
+	}
+
+	SinkIOStream str(sink);
+	try {
+		if(!ExportScene(str, NULL, NULL, scene, resolved)) {
+			if(error) {
+				*error = "failure writing to the sink";
+			}
+			return false;
+		}
+	}
+	catch(const std::exception& e) {
+		if(error) {
+			*error = e.what();
+		}
+		return false;
+	}
+	return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+bool Assimp2JsonWriteFile(const aiScene* scene, const char* file, const Assimp2JsonOptions& options, std::string* error,
+	Assimp::IOSystem* io)
+{
+	OutputFileIOSystem disk;
+	if(!io) {
+		io = &disk;
+	}
+
+	// sidecar files are named after the document without its compression suffix
+	Assimp2JsonOptions resolved = options;
+	std::string base_name;
+	const Assimp2JsonCompression by_name = CompressedIOStream::CodecFromFileName(file, &base_name);
+	if(resolved.compression == Assimp2JsonCompression_Auto) {
+		resolved.compression = by_name;
+	}
+
+	Assimp::IOStream* const str = io->Open(file,"wb");
+	if(!str) {
+		if(error) {
+			*error = std::string("could not open output file: ") + file;
+		}
+		return false;
+	}
+
+	bool ok;
+	try {
+		ok = ExportScene(*str, io, base_name.c_str(), scene, resolved);
+	}
+	catch(const std::exception& e) {
+		io->Close(str);
+		if(error) {
+			*error = e.what();
+		}
+		return false;
+	}
+	catch(...) {
+		io->Close(str);
+		throw;
+	}
+	io->Close(str);
+
+	if(!ok && error) {
+		*error = std::string("failure writing output file: ") + file;
+	}
+	return ok;
+}
@@ -0,0 +1,189 @@
+/*
+Assimp2Json
+Copyright (c) 2011, Alexander C. Gessler
+
+Licensed under a 3-clause BSD license. See the LICENSE file for more information.
+
+*/
+
+#ifndef INCLUDED_JSON_EXPORTER
+#define INCLUDED_JSON_EXPORTER
+
+#include <assimp/Exporter.hpp>
+
+// ----------------------------------------------------------------------------
+// Configuration keys understood by the assimp.json exporter. Pass them to
+// Assimp::Exporter::Export() through an Assimp::ExportProperties instance.
+// ----------------------------------------------------------------------------
+
+// ---------------------------------------------------------------------------
+/** Write minified JSON without any insignificant whitespace (no newlines,
+ *  no indentation, no spaces after delimiters). The default, pretty-printed
+ *  output is better suited for debugging.
+ *
+ *  Property type: bool. Default value: false
+ */
+#define ASSIMP2JSON_CONFIG_COMPACT "ASSIMP2JSON_COMPACT"
+
+// ---------------------------------------------------------------------------
+/** Write vertex attributes and face indices to little-endian binary sidecar
+ *  files (model.assimp.bin, model.assimp.1.bin, ...) next to the output
+ *  file, which makes them directly loadable as typed arrays. In the JSON
+ *  document, each of these arrays is replaced by a reference of the form
+ *
+ *    { "buffer": 0, "byteoffset": 1024, "count": 300, "components": 3, "type": "float32" }
+ *
+ *  where count is the number of items (vertices, faces) and components the
+ *  number of scalars per item. The sidecar files are listed in the scene's
+ *  "buffers" array. Meshes whose faces have differing numbers of indices
+ *  keep the nested "faces" arrays. If the sidecar files cannot be created,
+ *  the exporter falls back to plain JSON.
+ *
+ *  Property type: bool. Default value: false
+ */
+#define ASSIMP2JSON_CONFIG_BINARY_BUFFERS "ASSIMP2JSON_BINARY_BUFFERS"
+
+// ---------------------------------------------------------------------------
+/** Number of threads used to split meshes and to format meshes, materials,
+ *  animations and textures concurrently. Very large attribute and face
+ *  arrays of a single mesh are also split into segments which are
+ *  formatted concurrently. The output is identical to the serial output.
+ *  0 selects one thread per hardware thread. Data written to binary
+ *  sidecar files (see ASSIMP2JSON_CONFIG_BINARY_BUFFERS) is always
+ *  formatted on the calling thread.
+ *
+ *  Property type: integer. Default value: 1
+ */
+#define ASSIMP2JSON_CONFIG_THREADS "ASSIMP2JSON_THREADS"
+
+// ---------------------------------------------------------------------------
+/** Maximum number of vertices per mesh. Larger meshes are split into
+ *  several meshes, which are all referenced by the nodes that referenced
+ *  the original mesh. The default keeps all indices within 16 bits for
+ *  WebGL 1. 0 disables splitting, which also saves copying the scene.
+ *  Otherwise the limit must be at least 3 so that a part holds a triangle.
+ *
+ *  Property type: integer. Default value: 65536
+ */
+#define ASSIMP2JSON_CONFIG_SPLIT_LIMIT "ASSIMP2JSON_SPLIT_LIMIT"
+
+// ---------------------------------------------------------------------------
+/** Split meshes which exceed the vertex limit into compact parts grown over
+ *  shared vertices instead of filling parts in the original face order.
+ *  This reduces the number of vertices that are duplicated on the part
+ *  boundaries, in particular for meshes whose faces are not spatially
+ *  ordered.
+ *
+ *  Property type: bool. Default value: false
+ */
+#define ASSIMP2JSON_CONFIG_SPLIT_LOCALITY "ASSIMP2JSON_SPLIT_LOCALITY"
+
+// ---------------------------------------------------------------------------
+/** Reorder the triangles of the parts of split meshes for the GPU's
+ *  post-transform vertex cache. Meshes which are not split keep their
+ *  face order, aiProcess_ImproveCacheLocality takes care of those.
+ *
+ *  Property type: bool. Default value: false
+ */
+#define ASSIMP2JSON_CONFIG_OPTIMIZE_VERTEX_CACHE "ASSIMP2JSON_OPTIMIZE_VERTEX_CACHE"
+
+// ---------------------------------------------------------------------------
+/** Compression level for output files whose name ends in .gz (gzip, 1-9),
+ *  .zst (zstd, 1-22) or .br (brotli, 1-11). Such files are compressed while
+ *  they are written, with more than one thread (see
+ *  ASSIMP2JSON_CONFIG_THREADS) on a background thread and, for zstd, with
+ *  zstd's own worker threads. Binary sidecar files are named after the file
+ *  without the suffix and are not compressed. 0 selects the codec's default:
+ *  6 for gzip, 3 for zstd and 9 for brotli.
+ *
+ *  Property type: integer. Default value: 0
+ */
+#define ASSIMP2JSON_CONFIG_COMPRESSION_LEVEL "ASSIMP2JSON_COMPRESSION_LEVEL"
+
+// ---------------------------------------------------------------------------
+/** Write mesh vertex attributes as small integers instead of floats. Each
+ *  quantized attribute becomes an object which describes how to decode it:
+ *
+ *    { "encoding": "quantized", "bits": 16, "min": [...], "max": [...],
+ *      "count": 300, "components": 3, "type": "uint16", "data": [...] }
+ *
+ *  With ASSIMP2JSON_CONFIG_BINARY_BUFFERS, "data" is replaced by "buffer"
+ *  and "byteoffset" as for other arrays. "type" is the smallest integer
+ *  type which holds the values. The encodings are:
+ *
+ *  - "quantized": positions (see ASSIMP2JSON_CONFIG_QUANTIZE_POSITION_BITS)
+ *    and 16 bit texture coordinates. Each component is spread over its
+ *    range, so "min" and "max" of the positions are the mesh's bounding box.
+ *    A value decodes as min + q * (max - min) / (2^bits - 1).
+ *  - "octahedral": normals, tangents and bitangents as two signed integers
+ *    (see ASSIMP2JSON_CONFIG_QUANTIZE_NORMAL_BITS). With s = 2^(bits-1) - 1,
+ *    x = q0 / s, y = q1 / s and z = 1 - |x| - |y|. If z < 0, (x, y) becomes
+ *    ((1 - |y|) * sign(x), (1 - |x|) * sign(y)). The vector is then
+ *    normalized.
+ *  - "normalized": 8 bit vertex colors, a value decodes as q / (2^bits - 1).
+ *    Components outside [0,1] are clamped.
+ *
+ *  Property type: bool. Default value: false
+ */
+#define ASSIMP2JSON_CONFIG_QUANTIZE "ASSIMP2JSON_QUANTIZE"
+
+// ---------------------------------------------------------------------------
+/** Bits per component of quantized vertex positions, 1 to 24. Values out
+ *  of range are ignored.
+ *
+ *  Property type: integer. Default value: 16
+ */
+#define ASSIMP2JSON_CONFIG_QUANTIZE_POSITION_BITS "ASSIMP2JSON_QUANTIZE_POSITION_BITS"
+
+// ---------------------------------------------------------------------------
+/** Bits per component of octahedral normals, tangents and bitangents, 2 to
+ *  16. Values out of range are ignored.
+ *
+ *  Property type: integer. Default value: 12
+ */
+#define ASSIMP2JSON_CONFIG_QUANTIZE_NORMAL_BITS "ASSIMP2JSON_QUANTIZE_NORMAL_BITS"
+
+// ---------------------------------------------------------------------------
+/** Write the faces of meshes which consist of triangles only as one flat
+ *  "indices" array of 3 indices per triangle instead of nested "faces"
+ *  arrays, ready to be copied into a Uint16Array or Uint32Array. Meshes
+ *  with other primitives keep their "faces". "__metadata__" then has an
+ *  "indices" member of "flat". With ASSIMP2JSON_CONFIG_BINARY_BUFFERS,
+ *  which writes indices to the sidecar files as one block anyway, this has
+ *  no effect.
+ *
+ *  Property type: bool. Default value: false
+ */
+#define ASSIMP2JSON_CONFIG_FLAT_INDICES "ASSIMP2JSON_FLAT_INDICES"
+
+// ---------------------------------------------------------------------------
+/** Like ASSIMP2JSON_CONFIG_FLAT_INDICES, which this implies, but with the
+ *  indices encoded as one stream of small integers, which is shorter and
+ *  quicker to parse. Triangle meshes get an "indices" object instead:
+ *
+ *    { "encoding": "watermark", "count": 100, "components": 3, "data": [...] }
+ *
+ *  where count is the number of triangles and data holds 3 * count signed
+ *  integers, which decode to the indices in order:
+ *
+ *  - "delta": index = prev + code, prev = index, where prev starts at 0.
+ *  - "watermark": index = next - code, next = max(next, index + 1), where
+ *    next starts at 0. Every index which is one past the highest one so
+ *    far encodes as 0, so meshes whose vertices are ordered by first use
+ *    (such as the parts of split meshes) encode to mostly small numbers.
+ *
+ *  The "indices" member of "__metadata__" names the encoding. With
+ *  ASSIMP2JSON_CONFIG_BINARY_BUFFERS, indices go to the sidecar files
+ *  unencoded.
+ *
+ *  Any other value is treated as "none".
+ *
+ *  Property type: string, "none", "delta" or "watermark". Default value: "none"
+ */
+#define ASSIMP2JSON_CONFIG_INDEX_ENCODING "ASSIMP2JSON_INDEX_ENCODING"
+
+
+// json_exporter.cpp. Errors are thrown as std::runtime_error.
+extern Assimp::Exporter::ExportFormatEntry Assimp2Json_desc;
+
+#endif // INCLUDED_JSON_EXPORTER
@@ -7,22 +7,55 @@ Licensed under a 3-clause BSD license. See the LICENSE file for more information
 */
 
 #include <assimp/Importer.hpp>
-#include <assimp/Exporter.hpp>
 
 #include <assimp/version.h>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
 #include "version.h"
+#include "assimp2json.h"
+#include "stats.h"
+#include "server.h"
+#include "mmap_io_system.h"
+#include "alloc_counter.h"
 
-// json_exporter.cpp
-extern Assimp::Exporter::ExportFormatEntry Assimp2Json_desc;
+enum stats_format { stats_none, stats_text, stats_json };
+
+void write_stats(const ConversionStats& stats, stats_format format)
+{
+	// stderr, so they don't end up in the output on stdout
+	if (format == stats_json) {
+		stats.WriteJSON(std::cerr);
+	}
+	else if (format == stats_text) {
+		stats.WriteText(std::cerr);
+	}
+}
 
 int unrecog_exit(int ex = -1)
 {
-	std::cout << "usage: assimp2json [--log --verbose] input [output]" << std::endl;
+	std::cout << "usage: assimp2json [--compact] [--binary] [--threads n] [--split-limit n] [--split-locality] [--optimize-cache]\n"
+		<< "                   [--profile name] [--pp +step,-step] [--pp-timing] [--stats | --stats-json]\n"
+		<< "                   [--quantize [--position-bits n] [--normal-bits n]]\n"
+		<< "                   [--flat-indices] [--index-encoding delta|watermark|none]\n"
+		<< "                   [--compress gzip|zstd|brotli|none] [--compression-level n]\n"
+		<< "                   [--no-mmap] [--log --verbose] input [output]\n"
+		<< "       assimp2json --batch [--workers n] [flags] [input | @manifest | -] ...\n"
+		<< "       assimp2json --serve socket|- [--workers n] [flags]" << std::endl;
 	return ex;
 }
 
@@ -41,15 +74,538 @@ void printhelp()
 {
 }
 
+// `memory_map` reads input files through memory mappings instead of assimp's default stdio
+void setup_importer(Assimp::Importer& imp, bool memory_map)
+{
+	if (memory_map) {
+		// the importer takes ownership
+		imp.SetIOHandler(new MappedFileIOSystem());
+	}
+
+	// instruct aiProcess_FindDegenerates to drop degenerates 
+	imp.SetPropertyBool(AI_CONFIG_PP_FD_REMOVE, true);
+	// instruct aiProcess_SortByPrimitiveType to drop line and point meshes
+	imp.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+
+	// instruct aiProcess_GenSmoothNormals to not smooth normals with an angle of more than 70deg
+	imp.SetPropertyFloat(AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE, 70.0f);
+	// instruct aiProcess_CalcTangents to not smooth normals with an angle of more than 70deg
+	imp.SetPropertyFloat(AI_CONFIG_PP_CT_MAX_SMOOTHING_ANGLE, 70.0f);
+}
+
+struct pp_step { const char* name; unsigned int flag; };
+
+// post-processing steps which can be turned on and off by name, in the order in which assimp runs
+// them (see GetPostProcessingStepInstanceList() in assimp's PostStepRegistry.cpp). The data structure
+// is validated right after import, before any of the steps.
+const pp_step pp_steps[] = {
+	{ "ValidateDataStructure", aiProcess_ValidateDataStructure },
+	{ "MakeLeftHanded", aiProcess_MakeLeftHanded },
+	{ "FlipUVs", aiProcess_FlipUVs },
+	{ "FlipWindingOrder", aiProcess_FlipWindingOrder },
+	{ "RemoveComponent", aiProcess_RemoveComponent },
+	{ "RemoveRedundantMaterials", aiProcess_RemoveRedundantMaterials },
+	{ "FindInstances", aiProcess_FindInstances },
+	{ "OptimizeGraph", aiProcess_OptimizeGraph },
+	{ "OptimizeMeshes", aiProcess_OptimizeMeshes },
+	{ "FindDegenerates", aiProcess_FindDegenerates },
+	{ "GenUVCoords", aiProcess_GenUVCoords },
+	{ "TransformUVCoords", aiProcess_TransformUVCoords },
+	{ "PreTransformVertices", aiProcess_PreTransformVertices },
+	{ "Triangulate", aiProcess_Triangulate },
+	{ "SortByPType", aiProcess_SortByPType },
+	{ "FindInvalidData", aiProcess_FindInvalidData },
+	{ "FixInfacingNormals", aiProcess_FixInfacingNormals },
+	{ "SplitLargeMeshes", aiProcess_SplitLargeMeshes },
+	{ "GenNormals", aiProcess_GenNormals },
+	{ "GenSmoothNormals", aiProcess_GenSmoothNormals },
+	{ "CalcTangentSpace", aiProcess_CalcTangentSpace },
+	{ "JoinIdenticalVertices", aiProcess_JoinIdenticalVertices },
+	{ "LimitBoneWeights", aiProcess_LimitBoneWeights },
+	{ "ImproveCacheLocality", aiProcess_ImproveCacheLocality },
+};
+
+struct pp_profile { const char* name; unsigned int flags; unsigned int components; };
+
+// named sets of post-processing steps for --profile, plus the components aiProcess_RemoveComponent
+// drops (AI_CONFIG_PP_RVC_FLAGS) if the step is part of the profile or turned on with --pp
+const pp_profile pp_profiles[] = {
+	// everything it takes to make the scene fit for realtime rendering (the default)
+	{ "max-quality", aiProcessPreset_TargetRealtime_MaxQuality, 0 },
+	{ "quality", aiProcessPreset_TargetRealtime_Quality, 0 },
+	// triangulated, welded and with normals, but no smoothing or optimization
+	{ "fast", aiProcessPreset_TargetRealtime_Fast, 0 },
+	// positions and triangles only, all other vertex components are dropped
+	{ "geometry", aiProcess_RemoveComponent | aiProcess_Triangulate | aiProcess_JoinIdenticalVertices |
+		aiProcess_SortByPType | aiProcess_FindDegenerates,
+		aiComponent_NORMALS | aiComponent_TANGENTS_AND_BITANGENTS | aiComponent_COLORS | aiComponent_TEXCOORDS },
+	// the scene as the importer delivers it
+	{ "none", 0, 0 },
+};
+
+bool parse_profile(const char* name, unsigned int& flags, unsigned int& components)
+{
+	for (size_t i = 0; i < sizeof pp_profiles / sizeof pp_profiles[0]; ++i) {
+		if (!strcmp(name, pp_profiles[i].name)) {
+			flags = pp_profiles[i].flags;
+			components = pp_profiles[i].components;
+			return true;
+		}
+	}
+	return false;
+}
+
+// parse a comma-separated list of step names. Steps prefixed with '-' are added to
+// `off`, all others (optionally prefixed with '+') to `on`.
+bool parse_steps(const char* list, unsigned int& on, unsigned int& off)
+{
+	std::istringstream s(list);
+	std::string name;
+	while (std::getline(s, name, ',')) {
+		const bool remove = !name.empty() && name[0] == '-';
+		if (!name.empty() && (name[0] == '-' || name[0] == '+')) {
+			name.erase(0, 1);
+		}
+
+		size_t i = 0, end = sizeof pp_steps / sizeof pp_steps[0];
+		while (i < end && name != pp_steps[i].name) {
+			++i;
+		}
+		if (i == end) {
+			std::cerr << "unknown post-processing step: " << name << std::endl;
+			return false;
+		}
+
+		(remove ? off : on) |= pp_steps[i].flag;
+		(remove ? on : off) &= ~pp_steps[i].flag;
+	}
+	return true;
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point since)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+// import a file and apply the given post-processing steps, with `components` dropped by
+// aiProcess_RemoveComponent. If `timing` is given, the steps are applied one after the
+// other and the time spent in each of them is reported there.
+const aiScene* import_file(Assimp::Importer& imp, const char* in, unsigned int pp, unsigned int components,
+	std::ostream* timing)
+{
+	// importers are reused for conversions with different profiles, so this is set every time
+	imp.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, static_cast<int>(components));
+
+	if (!timing) {
+		return imp.ReadFile(in,pp);
+	}
+
+	*timing << std::fixed << std::setprecision(3);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	const aiScene* sc = imp.ReadFile(in,0);
+	*timing << "import " << elapsed_ms(start) << " ms\n";
+
+	const std::chrono::steady_clock::time_point pp_start = std::chrono::steady_clock::now();
+	unsigned int other = pp;
+	for (size_t i = 0; sc && i < sizeof pp_steps / sizeof pp_steps[0]; ++i) {
+		other &= ~pp_steps[i].flag;
+		if (pp & pp_steps[i].flag) {
+			start = std::chrono::steady_clock::now();
+			sc = imp.ApplyPostProcessing(pp_steps[i].flag);
+			*timing << "postprocess " << pp_steps[i].name << " " << elapsed_ms(start) << " ms\n";
+		}
+	}
+
+	// steps of a profile which are not in the table are still applied, together and last
+	if (sc && other) {
+		start = std::chrono::steady_clock::now();
+		sc = imp.ApplyPostProcessing(other);
+		*timing << "postprocess other (0x" << std::hex << other << std::dec << ") " << elapsed_ms(start) << " ms\n";
+	}
+	*timing << "postprocess total " << elapsed_ms(pp_start) << " ms\n";
+	return sc;
+}
+
+// append the input file names listed in a manifest file (or stdin for "-"), one per line
+bool read_manifest(const char* name, std::vector<std::string>& inputs)
+{
+	std::ifstream file;
+	if (strcmp(name,"-")) {
+		file.open(name);
+		if (!file) {
+			return false;
+		}
+	}
+
+	std::istream& in = file.is_open() ? static_cast<std::istream&>(file) : std::cin;
+	std::string line;
+	while(std::getline(in,line)) {
+		line.erase(line.find_last_not_of(" \t\r") + 1);
+		if (!line.empty()) {
+			inputs.push_back(line);
+		}
+	}
+	return true;
+}
+
+// convert `in` to `out` reusing the given importer
+bool convert_file(Assimp::Importer& imp, const std::string& in, const std::string& out,
+	const Assimp2JsonOptions& options, unsigned int pp, unsigned int components, std::ostream* timing,
+	std::string& error)
+{
+	const aiScene* sc;
+	{
+		StatsPhase phase("import");
+		sc = import_file(imp,in.c_str(),pp,components,timing);
+	}
+	if (!sc) {
+		error = std::string("failure reading file: ") + imp.GetErrorString();
+		return false;
+	}
+
+	bool ok;
+	{
+		StatsPhase phase("export");
+		ok = Assimp2JsonWriteFile(sc,out.c_str(),options,&error);
+	}
+	if (!ok) {
+		error = "failure exporting file: " + error;
+	}
+
+	imp.FreeScene();
+	return ok;
+}
+
+// file name suffix for output compressed with `codec`
+const char* compression_suffix(Assimp2JsonCompression codec)
+{
+	switch (codec) {
+		case Assimp2JsonCompression_Gzip:
+			return ".gz";
+		case Assimp2JsonCompression_Zstd:
+			return ".zst";
+		case Assimp2JsonCompression_Brotli:
+			return ".br";
+		default:
+			return "";
+	}
+}
+
+// convert all inputs to `input.json` (plus the suffix of the codec given with --compress) on a pool of worker threads, each of which has its own
+// importer. Results are reported on stdout as soon as each file is done.
+int run_batch(const std::vector<std::string>& inputs, unsigned int workers, const Assimp2JsonOptions& options,
+	unsigned int pp, unsigned int components, bool pp_timing, stats_format stats_fmt, bool memory_map)
+{
+	std::mutex mutex;
+	size_t next = 0, failed = 0;
+
+	auto worker = [&]() {
+		Assimp::Importer imp;
+		setup_importer(imp,memory_map);
+
+		for(;;) {
+			size_t n;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (next == inputs.size()) {
+					return;
+				}
+				n = next++;
+			}
+
+			const std::string out = inputs[n] + ".json" + compression_suffix(options.compression);
+			std::ostringstream timing;
+			std::string error;
+			bool ok;
+
+			ConversionStats stats(inputs[n]);
+			ConversionStats::SetCurrent(stats_fmt != stats_none ? &stats : NULL);
+			try {
+				ok = convert_file(imp,inputs[n],out,options,pp,components,pp_timing ? &timing : NULL,error);
+			}
+			catch(const std::exception& e) {
+				error = std::string("failure converting file: ") + e.what();
+				ok = false;
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (ok) {
+				std::cout << "ok " << inputs[n] << " -> " << out << std::endl;
+			}
+			else {
+				++failed;
+				std::cout << "failed " << inputs[n] << ": " << error << std::endl;
+			}
+			std::istringstream lines(timing.str());
+			for (std::string line; std::getline(lines,line);) {
+				std::cerr << inputs[n] << ": " << line << "\n";
+			}
+			ConversionStats::SetCurrent(NULL);
+			write_stats(stats,stats_fmt);
+		}
+	};
+
+	workers = std::max(1u, std::min(workers, static_cast<unsigned int>(inputs.size())));
+
+	std::vector<std::thread> pool;
+	for(unsigned int i = 0; i < workers; ++i) {
+		pool.push_back(std::thread(worker));
+	}
+	for(std::vector<std::thread>::iterator it = pool.begin(); it != pool.end(); ++it) {
+		(*it).join();
+	}
+
+	std::cout << "converted " << inputs.size() - failed << " of " << inputs.size() << " files" << std::endl;
+	return failed ? -6 : 0;
+}
+
+// per-conversion settings, given on the command line or with each --serve request
+struct conversion_settings
+{
+	conversion_settings()
+		: pp(aiProcessPreset_TargetRealtime_MaxQuality)
+		, pp_on()
+		, pp_off()
+		, components()
+	{}
+
+	unsigned int GetPostProcessing() const {
+		return (pp | pp_on) & ~pp_off;
+	}
+
+	Assimp2JsonOptions options;
+
+	// post-processing steps applied after import: a profile plus steps turned on or off
+	unsigned int pp, pp_on, pp_off;
+
+	// vertex components aiProcess_RemoveComponent drops, as given by the profile
+	unsigned int components;
+};
+
+enum flag_result { flag_ok, flag_unknown, flag_invalid };
+
+// parse the flag at args[i] if it is one of the per-conversion flags. Flags which take a
+// value advance `i` to it.
+flag_result parse_conversion_flag(int argc, const char* const* args, int& i, conversion_settings& settings)
+{
+	const char* const arg = args[i];
+	Assimp2JsonOptions& options = settings.options;
+
+	if (!strcmp(arg,"-c") || !strcmp(arg,"--compact")) {
+		options.compact = true;
+	}
+	else if (!strcmp(arg,"-b") || !strcmp(arg,"--binary")) {
+		options.binary_buffers = true;
+	}
+	else if (!strcmp(arg,"-j") || !strcmp(arg,"--threads")) {
+		// 0 picks one thread per core
+		if (++i == argc) {
+			return flag_invalid;
+		}
+		options.threads = static_cast<unsigned int>(std::max(0, atoi(args[i])));
+	}
+	else if (!strcmp(arg,"-s") || !strcmp(arg,"--split-limit")) {
+		// 0 disables splitting, a part must be able to hold at least one triangle
+		if (++i == argc) {
+			return flag_invalid;
+		}
+		options.split_limit = static_cast<unsigned int>(std::max(0, atoi(args[i])));
+		if (options.split_limit && options.split_limit < 3) {
+			return flag_invalid;
+		}
+	}
+	else if (!strcmp(arg,"--split-locality")) {
+		options.split_locality = true;
+	}
+	else if (!strcmp(arg,"--optimize-cache")) {
+		options.optimize_vertex_cache = true;
+	}
+	else if (!strcmp(arg,"-q") || !strcmp(arg,"--quantize")) {
+		options.quantize = true;
+	}
+	else if (!strcmp(arg,"--position-bits")) {
+		if (++i == argc) {
+			return flag_invalid;
+		}
+		options.position_bits = static_cast<unsigned int>(std::max(0, atoi(args[i])));
+	}
+	else if (!strcmp(arg,"--normal-bits")) {
+		if (++i == argc) {
+			return flag_invalid;
+		}
+		options.normal_bits = static_cast<unsigned int>(std::max(0, atoi(args[i])));
+	}
+	else if (!strcmp(arg,"--flat-indices")) {
+		options.flat_indices = true;
+	}
+	else if (!strcmp(arg,"--index-encoding")) {
+		if (++i == argc) {
+			return flag_invalid;
+		}
+		if (!strcmp(args[i],"delta")) {
+			options.index_encoding = Assimp2JsonIndexEncoding_Delta;
+		}
+		else if (!strcmp(args[i],"watermark")) {
+			options.index_encoding = Assimp2JsonIndexEncoding_Watermark;
+		}
+		else if (!strcmp(args[i],"none")) {
+			options.index_encoding = Assimp2JsonIndexEncoding_None;
+		}
+		else {
+			return flag_invalid;
+		}
+	}
+	else if (!strcmp(arg,"--compress")) {
+		// overrides the codec picked by the output file's suffix, also compresses stdout
+		if (++i == argc) {
+			return flag_invalid;
+		}
+		if (!strcmp(args[i],"gzip")) {
+			options.compression = Assimp2JsonCompression_Gzip;
+		}
+		else if (!strcmp(args[i],"zstd")) {
+			options.compression = Assimp2JsonCompression_Zstd;
+		}
+		else if (!strcmp(args[i],"brotli")) {
+			options.compression = Assimp2JsonCompression_Brotli;
+		}
+		else if (!strcmp(args[i],"none")) {
+			options.compression = Assimp2JsonCompression_None;
+		}
+		else {
+			return flag_invalid;
+		}
+	}
+	else if (!strcmp(arg,"--compression-level")) {
+		// 0 picks the codec's default
+		if (++i == argc) {
+			return flag_invalid;
+		}
+		options.compression_level = atoi(args[i]);
+	}
+	else if (!strcmp(arg,"--profile")) {
+		if (++i == argc || !parse_profile(args[i],settings.pp,settings.components)) {
+			return flag_invalid;
+		}
+	}
+	else if (!strcmp(arg,"--pp")) {
+		if (++i == argc || !parse_steps(args[i],settings.pp_on,settings.pp_off)) {
+			return flag_invalid;
+		}
+	}
+	else {
+		return flag_unknown;
+	}
+	return flag_ok;
+}
+
+// handle a --serve request: `[flags] input`, where the flags apply on top of the server's.
+// Everything after the flags is the input file name, so it may contain spaces.
+void serve_request(Assimp::Importer& imp, const std::string& request, const conversion_settings& defaults,
+	ServerResponse& response)
+{
+	conversion_settings settings = defaults;
+
+	std::vector<std::string> words;
+	std::vector<size_t> offsets;
+	for (size_t pos = request.find_first_not_of(" \t"); pos != std::string::npos; ) {
+		const size_t end = std::min(request.length(), request.find_first_of(" \t", pos));
+		words.push_back(request.substr(pos, end - pos));
+		offsets.push_back(pos);
+		pos = request.find_first_not_of(" \t", end);
+	}
+
+	std::vector<const char*> args;
+	for (std::vector<std::string>::const_iterator it = words.begin(); it != words.end(); ++it) {
+		args.push_back((*it).c_str());
+	}
+
+	const int count = static_cast<int>(args.size());
+	int i = 0;
+	while (i < count && args[i][0] == '-') {
+		if (parse_conversion_flag(count,&args[0],i,settings) != flag_ok) {
+			response.Error(std::string("invalid flag: ") + args[std::min(i, count - 1)]);
+			return;
+		}
+		++i;
+	}
+	if (i == count) {
+		response.Error("no input file given");
+		return;
+	}
+
+	const std::string in = request.substr(offsets[i]);
+	const aiScene* const sc = import_file(imp,in.c_str(),settings.GetPostProcessing(),settings.components,NULL);
+	if (!sc) {
+		response.Error(std::string("failure reading file: ") + imp.GetErrorString());
+		return;
+	}
+
+	std::string error;
+	if (!Assimp2JsonWrite(sc,response.Begin(),settings.options,&error)) {
+		response.Error("failure exporting file: " + error);
+	}
+	else {
+		response.End();
+	}
+	imp.FreeScene();
+}
+
+// run the conversion server on a socket, or on stdin/stdout for "-", with one importer per
+// worker thread which is reused for all requests the worker handles
+int run_server(const char* address, unsigned int workers, const conversion_settings& settings, bool memory_map)
+{
+	workers = std::max(1u, workers);
+
+	std::vector<Assimp::Importer> importers(workers);
+	for (std::vector<Assimp::Importer>::iterator it = importers.begin(); it != importers.end(); ++it) {
+		setup_importer(*it,memory_map);
+	}
+
+	auto handler = [&](unsigned int worker, const std::string& request, ServerResponse& response) {
+		try {
+			serve_request(importers[worker],request,settings,response);
+		}
+		catch(const std::exception& e) {
+			importers[worker].FreeScene();
+			response.Error(std::string("failure converting file: ") + e.what());
+		}
+	};
+
+	if (!strcmp(address,"-")) {
+		return ServeStdio(handler);
+	}
+	return ServeSocket(address,workers,handler);
+}
+
 int main (int argc, char *argv[])
 {
 	if (argc == 1) {
 		return unrecog_exit(-1);
 	}
 
+	conversion_settings settings;
+	bool pp_timing = false;
+
+	stats_format stats_fmt = stats_none;
+
+	bool batch = false;
+	// 0 picks one worker per core
+	unsigned int workers = 0;
+
+	const char* serve = NULL;
+	bool memory_map = true;
+
 	int nextarg = 1;
 	while(nextarg < argc && argv[nextarg][0] == '-') {
-		if (!strcmp(argv[nextarg],"--help")) {
+		const flag_result conversion_flag = parse_conversion_flag(argc,argv,nextarg,settings);
+		if (conversion_flag == flag_invalid) {
+			return unrecog_exit(-2);
+		}
+		else if (conversion_flag == flag_ok) {
+		}
+		else if (!strcmp(argv[nextarg],"--help")) {
 			printhelp();
 			return 0;
 		}
@@ -57,52 +613,131 @@ int main (int argc, char *argv[])
 			printver();
 			return 0;
 		}
+		else if (!strcmp(argv[nextarg],"--no-mmap")) {
+			memory_map = false;
+		}
+		else if (!strcmp(argv[nextarg],"--pp-timing")) {
+			pp_timing = true;
+		}
+		else if (!strcmp(argv[nextarg],"--stats")) {
+			stats_fmt = stats_text;
+		}
+		else if (!strcmp(argv[nextarg],"--stats-json")) {
+			stats_fmt = stats_json;
+		}
+		else if (!strcmp(argv[nextarg],"--batch")) {
+			batch = true;
+		}
+		else if (!strcmp(argv[nextarg],"-w") || !strcmp(argv[nextarg],"--workers")) {
+			if (++nextarg == argc) {
+				return unrecog_exit(-2);
+			}
+			workers = static_cast<unsigned int>(std::max(0, atoi(argv[nextarg])));
+		}
+		else if (!strcmp(argv[nextarg],"--serve")) {
+			// socket path, or - for stdin/stdout
+			if (++nextarg == argc) {
+				return unrecog_exit(-2);
+			}
+			serve = argv[nextarg];
+		}
+		else if (!strcmp(argv[nextarg],"-")) {
+			// stdin input list for --batch
+			break;
+		}
 		++nextarg;
 	}
 
+	const Assimp2JsonOptions& options = settings.options;
+	const unsigned int pp = settings.GetPostProcessing();
+
+	if (stats_fmt != stats_none) {
+		EnableAllocationCounting();
+	}
+
+	if (serve) {
+		return run_server(serve, workers ? workers : std::thread::hardware_concurrency(), settings, memory_map);
+	}
+
+	if (batch) {
+		// inputs are given directly, as @manifest files, or read from stdin if none are given
+		std::vector<std::string> inputs;
+		for(int i = nextarg; i < argc; ++i) {
+			if (argv[i][0] == '@' || !strcmp(argv[i],"-")) {
+				const char* const manifest = argv[i][0] == '@' ? argv[i] + 1 : argv[i];
+				if (!read_manifest(manifest,inputs)) {
+					std::cerr << "failure reading manifest: " << manifest << std::endl;
+					return -3;
+				}
+			}
+			else {
+				inputs.push_back(argv[i]);
+			}
+		}
+		if (nextarg == argc) {
+			read_manifest("-",inputs);
+		}
+
+		if (inputs.empty()) {
+			return 0;
+		}
+		return run_batch(inputs, workers ? workers : std::thread::hardware_concurrency(), options, pp, settings.components, pp_timing, stats_fmt, memory_map);
+	}
+
 	if (argc < nextarg+1) {
 		return unrecog_exit(-2);
 	}
 
 	const char* in = argv[nextarg], *out = (argc < nextarg+2 ? NULL : argv[nextarg+1]);
+	if (!out && options.binary_buffers) {
+		std::cerr << "binary buffers are written next to the output file, an output file is required" << std::endl;
+		return unrecog_exit(-2);
+	}
 	
-	Assimp::Importer imp;
-
-	// instruct aiProcess_FindDegenerates to drop degenerates 
-	imp.SetPropertyBool(AI_CONFIG_PP_FD_REMOVE, true);
-	// instruct aiProcess_SortByPrimitiveType to drop line and point meshes
-	imp.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+	ConversionStats stats(in);
+	if (stats_fmt != stats_none) {
+		ConversionStats::SetCurrent(&stats);
+	}
 
-	// instruct aiProcess_GenSmoothNormals to not smooth normals with an angle of more than 70deg
-	imp.SetPropertyFloat(AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE, 70.0f);
-	// instruct aiProcess_CalcTangents to not smooth normals with an angle of more than 70deg
-	imp.SetPropertyFloat(AI_CONFIG_PP_CT_MAX_SMOOTHING_ANGLE, 70.0f);
+	Assimp::Importer imp;
+	setup_importer(imp,memory_map);
 
-	const aiScene* const sc = imp.ReadFile(in,aiProcessPreset_TargetRealtime_MaxQuality);
+	// timings go to stderr so they don't end up in the output on stdout
+	const aiScene* sc;
+	{
+		StatsPhase phase("import");
+		sc = import_file(imp,in,pp,settings.components,pp_timing ? &std::cerr : NULL);
+	}
 	if (!sc) {
 		std::cerr << "failure reading file: " << in << std::endl;
 		return -3;
 	}
 
-	Assimp::Exporter exp;
-	exp.RegisterExporter(Assimp2Json_desc);
-
+	std::string error;
 	if(out) {
-		if(aiReturn_SUCCESS != exp.Export(sc,"assimp.json",out)) {
-			std::cerr << "failure exporting file: " << out << ": " << exp.GetErrorString() << std::endl;
+		StatsPhase phase("export");
+		if(!Assimp2JsonWriteFile(sc,out,options,&error)) {
+			std::cerr << "failure exporting file: " << out << ": " << error << std::endl;
 			return -4;
 		}
 	}
 	else {
-		// write to stdout, but we might do better than using ExportToBlob()
-		const aiExportDataBlob* const blob = exp.ExportToBlob(sc,"assimp.json");
-		if(!blob) {
-			std::cerr << "failure exporting to (stdout) " << exp.GetErrorString() << std::endl;
+		// stream to stdout as the output is produced rather than collecting it in memory first
+		Assimp2JsonFileDescriptorSink sink(1);
+
+		std::cout.flush();
+		StatsPhase phase("export");
+		if(!Assimp2JsonWrite(sc,sink,options,&error)) {
+			std::cerr << "failure exporting to (stdout) " << error << std::endl;
 			return -5;
 		}
-
-		const std::string s(static_cast<char*>( blob->data), blob->size);
-		std::cout << s << std::endl;
+		if (options.compression == Assimp2JsonCompression_Auto || options.compression == Assimp2JsonCompression_None) {
+			// a compressed stream must not be followed by anything
+			std::cout << std::endl;
+		}
 	}
+
+	ConversionStats::SetCurrent(NULL);
+	write_stats(stats,stats_fmt);
 	return 0;
 }
@@ -11,57 +11,217 @@ Licensed under a 3-clause BSD license. See the LICENSE file for more information
 
 #include <assimp/scene.h>
 
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <exception>
+
 // ----------------------------------------------------------------------------
 // Note: this is largely based on assimp's SplitLargeMeshes_Vertex process.
 // it is refactored and the coding style is slightly improved, though.
 // ----------------------------------------------------------------------------
 
+// ------------------------------------------------------------------------------------------------
+MeshSplitter::Stats& MeshSplitter::Stats :: operator += (const Stats& other)
+{
+	split_meshes += other.split_meshes;
+	parts += other.parts;
+	vertices_in += other.vertices_in;
+	vertices_out += other.vertices_out;
+	triangles_in += other.triangles_in;
+	triangles_out += other.triangles_out;
+	cache_misses_in += other.cache_misses_in;
+	cache_misses_out += other.cache_misses_out;
+	return *this;
+}
+
+// ------------------------------------------------------------------------------------------------
+double MeshSplitter::Stats :: GetDuplicationRatio() const
+{
+	return vertices_in ? static_cast<double>(vertices_out - vertices_in) / vertices_in : 0.;
+}
+
+// ------------------------------------------------------------------------------------------------
+double MeshSplitter::Stats :: GetACMRBefore() const
+{
+	return triangles_in ? static_cast<double>(cache_misses_in) / triangles_in : 0.;
+}
+
+// ------------------------------------------------------------------------------------------------
+double MeshSplitter::Stats :: GetACMRAfter() const
+{
+	return triangles_out ? static_cast<double>(cache_misses_out) / triangles_out : 0.;
+}
+
 // ------------------------------------------------------------------------------------------------
 // Executes the post processing step on the given imported data.
 void MeshSplitter :: Execute( aiScene* pScene)
 {
 	std::vector<std::pair<aiMesh*, unsigned int> > source_mesh_map;
+	std::vector<unsigned int> mesh_ranges;
+
+	const std::vector<aiMesh*> sources(pScene->mMeshes, pScene->mMeshes + pScene->mNumMeshes);
+	if (!SplitAll(pScene,source_mesh_map,mesh_ranges)) {
+		return;
+	}
+
+	// SplitMesh() leaves the original meshes alone. Delete those which have
+	// been replaced by their parts, i.e. which are no longer in the list.
+	std::vector<bool> kept(sources.size(), false);
+	for (unsigned int i = 0, end = static_cast<unsigned int>(source_mesh_map.size()); i < end;++i) {
+		const unsigned int a = source_mesh_map[i].second;
+		if (source_mesh_map[i].first == sources[a]) {
+			kept[a] = true;
+		}
+	}
+
+	for (unsigned int a = 0; a < sources.size();++a) {
+		if (!kept[a]) {
+			delete sources[a];
+		}
+	}
+
+	// now we need to update all nodes
+	UpdateNode(pScene->mRootNode,mesh_ranges);
+}
+
+// ------------------------------------------------------------------------------------------------
+// Executes the post processing step on a scene which shares its data with someone else.
+bool MeshSplitter :: ExecuteShared( aiScene* pScene)
+{
+	std::vector<std::pair<aiMesh*, unsigned int> > source_mesh_map;
+	std::vector<unsigned int> mesh_ranges;
+	if (!SplitAll(pScene,source_mesh_map,mesh_ranges)) {
+		return false;
+	}
+
+	// leave the shared node hierarchy alone and work on a copy
+	pScene->mRootNode = CopyNode(pScene->mRootNode,NULL,mesh_ranges);
+	return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Splits all meshes that exceed the limit and rebuilds the scene's mesh list. Returns true if
+// any mesh was split, in which case source_mesh_map holds the new meshes and their source index.
+// The parts of source mesh a are the new meshes [mesh_ranges[a],mesh_ranges[a+1]).
+bool MeshSplitter :: SplitAll( aiScene* pScene, std::vector<std::pair<aiMesh*, unsigned int> >& source_mesh_map,
+	std::vector<unsigned int>& mesh_ranges)
+{
+	stats = Stats();
+
+	// the parts of each mesh are collected separately so that meshes can be split concurrently
+	std::vector<std::vector<std::pair<aiMesh*, unsigned int> > > parts(pScene->mNumMeshes);
+	std::vector<Stats> part_stats(pScene->mNumMeshes);
 
+	std::vector<unsigned int> oversized;
 	for( unsigned int a = 0; a < pScene->mNumMeshes; a++) {
-		SplitMesh(a, pScene->mMeshes[a],source_mesh_map);
+		if (pScene->mMeshes[a]->mNumVertices > LIMIT) {
+			oversized.push_back(a);
+		}
+		else {
+			parts[a].push_back(std::make_pair(pScene->mMeshes[a],a));
+		}
 	}
 
-	const unsigned int size = static_cast<unsigned int>(source_mesh_map.size());
-	if (size != pScene->mNumMeshes)
-	{
-		// it seems something has been split. rebuild the mesh list
-		delete[] pScene->mMeshes;
-		pScene->mNumMeshes = size;
-		pScene->mMeshes = new aiMesh*[size]();
+	if (oversized.empty()) {
+		return false;
+	}
 
-		for (unsigned int i = 0; i < size;++i) {
-			pScene->mMeshes[i] = source_mesh_map[i].first;
+	const unsigned int workers = std::min(threads, static_cast<unsigned int>(oversized.size()));
+	if (workers <= 1) {
+		for (std::vector<unsigned int>::const_iterator it = oversized.begin(), end = oversized.end(); it != end;++it) {
+			SplitMesh(*it, pScene->mMeshes[*it], parts[*it], part_stats[*it]);
 		}
+	}
+	else {
+		std::atomic<size_t> next(0);
+		std::exception_ptr error;
+		std::mutex mutex;
+
+		auto worker = [&]() {
+			for (size_t i; (i = next++) < oversized.size();) {
+				const unsigned int a = oversized[i];
+				try {
+					SplitMesh(a, pScene->mMeshes[a], parts[a], part_stats[a]);
+				}
+				catch(...) {
+					std::lock_guard<std::mutex> lock(mutex);
+					if (!error) {
+						error = std::current_exception();
+					}
+					next = oversized.size();
+					return;
+				}
+			}
+		};
 
-		// now we need to update all nodes
-		UpdateNode(pScene->mRootNode,source_mesh_map);
+		std::vector<std::thread> pool;
+		for (unsigned int i = 0; i < workers;++i) {
+			pool.push_back(std::thread(worker));
+		}
+		for (std::vector<std::thread>::iterator it = pool.begin(); it != pool.end();++it) {
+			(*it).join();
+		}
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
 	}
+
+	// merge the parts in mesh order, which gives the same result as splitting one mesh after the other
+	mesh_ranges.clear();
+	mesh_ranges.reserve(pScene->mNumMeshes + 1);
+	mesh_ranges.push_back(0);
+
+	for( unsigned int a = 0; a < pScene->mNumMeshes; a++) {
+		source_mesh_map.insert(source_mesh_map.end(), parts[a].begin(), parts[a].end());
+		mesh_ranges.push_back(static_cast<unsigned int>(source_mesh_map.size()));
+		stats += part_stats[a];
+	}
+
+	// it seems something has been split. rebuild the mesh list
+	const unsigned int size = static_cast<unsigned int>(source_mesh_map.size());
+
+	delete[] pScene->mMeshes;
+	pScene->mNumMeshes = size;
+	pScene->mMeshes = new aiMesh*[size]();
+
+	for (unsigned int i = 0; i < size;++i) {
+		pScene->mMeshes[i] = source_mesh_map[i].first;
+	}
+	return true;
 }
 
 
 // ------------------------------------------------------------------------------------------------
-void MeshSplitter :: UpdateNode(aiNode* pcNode, const std::vector<std::pair<aiMesh*, unsigned int> >& source_mesh_map)
+void MeshSplitter :: RemapMeshIndices(const aiNode* pcNode, const std::vector<unsigned int>& mesh_ranges,
+	std::vector<unsigned int>& aiEntries)
 {
-	// TODO: should better use std::(multi)set for source_mesh_map.
-
-	// for every index in out list build a new entry
-	std::vector<unsigned int> aiEntries;
+	// replace every mesh index by the indices of all of its parts
+	aiEntries.clear();
 	aiEntries.reserve(pcNode->mNumMeshes + 1);
 	for (unsigned int i = 0; i < pcNode->mNumMeshes;++i)	{
-		for (unsigned int a = 0, end = static_cast<unsigned int>(source_mesh_map.size()); a < end;++a)	{
-			if (source_mesh_map[a].second == pcNode->mMeshes[i])	{
-				aiEntries.push_back(a);
-			}
+		const unsigned int source = pcNode->mMeshes[i];
+		if (source + 1 >= mesh_ranges.size()) {
+			// invalid mesh reference, drop it
+			continue;
+		}
+		for (unsigned int a = mesh_ranges[source], end = mesh_ranges[source + 1]; a < end;++a)	{
+			aiEntries.push_back(a);
 		}
 	}
+}
+
+
+// ------------------------------------------------------------------------------------------------
+void MeshSplitter :: UpdateNode(aiNode* pcNode, const std::vector<unsigned int>& mesh_ranges)
+{
+	std::vector<unsigned int> aiEntries;
+	RemapMeshIndices(pcNode, mesh_ranges, aiEntries);
 
 	// now build the new list
-	delete pcNode->mMeshes;
+	delete[] pcNode->mMeshes;
 	pcNode->mNumMeshes = static_cast<unsigned int>(aiEntries.size());
 	pcNode->mMeshes = new unsigned int[pcNode->mNumMeshes];
 
@@ -71,13 +231,45 @@ void MeshSplitter :: UpdateNode(aiNode* pcNode, const std::vector<std::pair<aiMe
 
 	// recursively update children
 	for (unsigned int i = 0, end = pcNode->mNumChildren; i < end;++i)	{
-		UpdateNode ( pcNode->mChildren[i], source_mesh_map );
+		UpdateNode ( pcNode->mChildren[i], mesh_ranges );
 	}
 	return;
 }
 
+
+// ------------------------------------------------------------------------------------------------
+aiNode* MeshSplitter :: CopyNode(const aiNode* pcNode, aiNode* parent, const std::vector<unsigned int>& mesh_ranges)
+{
+	aiNode* const out = new aiNode();
+	out->mName = pcNode->mName;
+	out->mTransformation = pcNode->mTransformation;
+	out->mParent = parent;
+
+	std::vector<unsigned int> aiEntries;
+	RemapMeshIndices(pcNode, mesh_ranges, aiEntries);
+
+	out->mNumMeshes = static_cast<unsigned int>(aiEntries.size());
+	if (out->mNumMeshes) {
+		out->mMeshes = new unsigned int[out->mNumMeshes];
+		std::copy(aiEntries.begin(), aiEntries.end(), out->mMeshes);
+	}
+
+	// recursively copy children
+	if (pcNode->mNumChildren) {
+		out->mNumChildren = pcNode->mNumChildren;
+		out->mChildren = new aiNode*[pcNode->mNumChildren];
+		for (unsigned int i = 0, end = pcNode->mNumChildren; i < end;++i)	{
+			out->mChildren[i] = CopyNode ( pcNode->mChildren[i], out, mesh_ranges );
+		}
+	}
+	return out;
+}
+
 #define WAS_NOT_COPIED 0xffffffff
 
+// size of the FIFO vertex cache assumed for statistics and for OptimizeVertexCache()
+#define VERTEX_CACHE_SIZE 16
+
 typedef std::pair <unsigned int,float> PerVertexWeight;
 typedef std::vector	<PerVertexWeight> VertexWeightTable;
 
@@ -101,19 +293,271 @@ VertexWeightTable* ComputeVertexBoneWeightTable(const aiMesh* pMesh)
 }
 
 // ------------------------------------------------------------------------------------------------
-void MeshSplitter :: SplitMesh(unsigned int a, aiMesh* in_mesh,
-	std::vector<std::pair<aiMesh*, unsigned int> >& source_mesh_map)
+// Number of triangles a face contributes for the purpose of the average cache miss ratio
+unsigned int CountTriangles(const aiMesh* pMesh)
 {
-	// TODO: should better use std::(multi)set for source_mesh_map.
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < pMesh->mNumFaces;++i) {
+		const unsigned int n = pMesh->mFaces[i].mNumIndices;
+		count += n > 2 ? n - 2 : 1;
+	}
+	return count;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Counts the misses of a FIFO vertex cache of the given size when rendering the faces of a mesh
+// in order. `stamp` is scratch memory.
+size_t CountCacheMisses(const aiMesh* pMesh, unsigned int cache_size, std::vector<size_t>& stamp)
+{
+	// a vertex is in the cache if it was one of the last cache_size misses
+	stamp.assign(pMesh->mNumVertices, 0);
+
+	size_t misses = 0;
+	for (unsigned int i = 0; i < pMesh->mNumFaces;++i) {
+		const aiFace& face = pMesh->mFaces[i];
+		for (unsigned int v = 0; v < face.mNumIndices;++v) {
+			size_t& s = stamp[face.mIndices[v]];
+			if (!s || s + cache_size <= misses) {
+				s = ++misses;
+			}
+		}
+	}
+	return misses;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Builds the vertex to face adjacency of a mesh. The faces using vertex v are
+// adjacency[offsets[v]] ... adjacency[offsets[v+1]-1]
+void ComputeVertexFaceAdjacency(const aiMesh* pMesh, std::vector<unsigned int>& offsets, std::vector<unsigned int>& adjacency)
+{
+	offsets.assign(pMesh->mNumVertices + 1, 0);
+	for (unsigned int i = 0; i < pMesh->mNumFaces;++i) {
+		const aiFace& face = pMesh->mFaces[i];
+		for (unsigned int v = 0; v < face.mNumIndices;++v) {
+			++offsets[face.mIndices[v] + 1];
+		}
+	}
+
+	for (unsigned int v = 0; v < pMesh->mNumVertices;++v) {
+		offsets[v + 1] += offsets[v];
+	}
+
+	std::vector<unsigned int> cursor(offsets.begin(), offsets.end() - 1);
+	adjacency.resize(offsets.back());
+	for (unsigned int i = 0; i < pMesh->mNumFaces;++i) {
+		const aiFace& face = pMesh->mFaces[i];
+		for (unsigned int v = 0; v < face.mNumIndices;++v) {
+			adjacency[cursor[face.mIndices[v]]++] = i;
+		}
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+// Computes an order of the faces of a mesh in which parts of no more than `limit` vertices are
+// grown from a seed face over shared vertices, so that the parts are compact and share only few
+// vertices with each other. The parts are delimited the same way as in SplitMesh(), so filling
+// parts in this order reproduces them.
+void ComputeLocalFaceOrder(const aiMesh* pMesh, unsigned int limit, std::vector<unsigned int>& order)
+{
+	std::vector<unsigned int> offsets, adjacency;
+	ComputeVertexFaceAdjacency(pMesh, offsets, adjacency);
+
+	// the part each vertex was last added to and the part each face was last queued for
+	std::vector<unsigned int> vertex_part(pMesh->mNumVertices, WAS_NOT_COPIED);
+	std::vector<unsigned int> face_part(pMesh->mNumFaces, WAS_NOT_COPIED);
+	std::vector<bool> emitted(pMesh->mNumFaces, false);
+
+	// faces adjacent to the current part, in the order they were found
+	std::vector<unsigned int> queue;
+	size_t head = 0;
+
+	order.clear();
+	order.reserve(pMesh->mNumFaces);
+
+	unsigned int part = 0, vertices = 0, seed = 0;
+	while (order.size() < pMesh->mNumFaces) {
+		unsigned int f;
+		while (head < queue.size() && emitted[queue[head]]) {
+			++head;
+		}
+		if (head < queue.size()) {
+			f = queue[head++];
+		}
+		else {
+			// start over from the first face not yet used
+			while (emitted[seed]) {
+				++seed;
+			}
+			f = seed;
+		}
+
+		const aiFace& face = pMesh->mFaces[f];
+		unsigned int need = 0;
+		for (unsigned int v = 0; v < face.mNumIndices;++v) {
+			if (vertex_part[face.mIndices[v]] != part) {
+				++need;
+			}
+		}
+
+		if (vertices + need > limit && vertices) {
+			// the face starts the next part, continuing where this one left off
+			++part;
+			vertices = 0;
+			queue.clear();
+			head = 0;
+			queue.push_back(f);
+			face_part[f] = part;
+			continue;
+		}
 
+		order.push_back(f);
+		emitted[f] = true;
+		for (unsigned int v = 0; v < face.mNumIndices;++v) {
+			const unsigned int index = face.mIndices[v];
+			if (vertex_part[index] == part) {
+				continue;
+			}
+			vertex_part[index] = part;
+			++vertices;
+
+			for (unsigned int a = offsets[index]; a < offsets[index + 1];++a) {
+				const unsigned int g = adjacency[a];
+				if (!emitted[g] && face_part[g] != part) {
+					face_part[g] = part;
+					queue.push_back(g);
+				}
+			}
+		}
+
+		if (vertices >= limit) {
+			++part;
+			vertices = 0;
+			queue.clear();
+			head = 0;
+		}
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+// Reorders the triangles of a mesh for the post-transform vertex cache, using the Tipsify
+// algorithm of Sander, Nehab and Barczak ("Fast Triangle Reordering for Vertex Locality and
+// Reduced Overdraw", SIGGRAPH 2007). The mesh must only consist of triangles.
+void OptimizeVertexCache(aiMesh* pMesh, unsigned int cache_size)
+{
+	const unsigned int nv = pMesh->mNumVertices, nt = pMesh->mNumFaces;
+	if (!nv || !nt) {
+		return;
+	}
+
+	std::vector<unsigned int> offsets, adjacency;
+	ComputeVertexFaceAdjacency(pMesh, offsets, adjacency);
+
+	// number of triangles not yet emitted per vertex
+	std::vector<unsigned int> live(nv);
+	for (unsigned int v = 0; v < nv;++v) {
+		live[v] = offsets[v + 1] - offsets[v];
+	}
+
+	std::vector<unsigned int> cache_time(nv, 0), dead_end, candidates, order;
+	std::vector<bool> emitted(nt, false);
+	order.reserve(nt);
+
+	unsigned int time = cache_size + 1, cursor = 0;
+	for (int fanning = 0; fanning >= 0;) {
+		// emit all remaining triangles around the fanning vertex
+		candidates.clear();
+		for (unsigned int a = offsets[fanning]; a < offsets[fanning + 1];++a) {
+			const unsigned int t = adjacency[a];
+			if (emitted[t]) {
+				continue;
+			}
+			emitted[t] = true;
+			order.push_back(t);
+
+			const aiFace& face = pMesh->mFaces[t];
+			for (unsigned int v = 0; v < face.mNumIndices;++v) {
+				const unsigned int index = face.mIndices[v];
+				dead_end.push_back(index);
+				candidates.push_back(index);
+				--live[index];
+				if (time - cache_time[index] > cache_size) {
+					cache_time[index] = time++;
+				}
+			}
+		}
+
+		// pick the next fanning vertex among the vertices just used, preferring those
+		// which are still in the cache and remain so after all their triangles are emitted
+		fanning = -1;
+		int best = -1;
+		for (std::vector<unsigned int>::const_iterator it = candidates.begin(), end = candidates.end(); it != end;++it) {
+			if (!live[*it]) {
+				continue;
+			}
+			int priority = 0;
+			if (time - cache_time[*it] + 2 * live[*it] <= cache_size) {
+				priority = static_cast<int>(time - cache_time[*it]);
+			}
+			if (priority > best) {
+				best = priority;
+				fanning = static_cast<int>(*it);
+			}
+		}
+
+		// otherwise continue with a recently used vertex, or with the next one in input order
+		while (fanning < 0 && !dead_end.empty()) {
+			const unsigned int index = dead_end.back();
+			dead_end.pop_back();
+			if (live[index]) {
+				fanning = static_cast<int>(index);
+			}
+		}
+		if (fanning < 0) {
+			while (cursor < nv && !live[cursor]) {
+				++cursor;
+			}
+			if (cursor < nv) {
+				fanning = static_cast<int>(cursor);
+			}
+		}
+	}
+
+	// all faces are triangles, so only the index arrays need to be moved around
+	std::vector<unsigned int*> indices(nt);
+	for (unsigned int i = 0; i < nt;++i) {
+		indices[i] = pMesh->mFaces[order[i]].mIndices;
+	}
+	for (unsigned int i = 0; i < nt;++i) {
+		pMesh->mFaces[i].mIndices = indices[i];
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+// Splits in_mesh if it exceeds the limit and appends the result to source_mesh_map. in_mesh itself
+// is never modified or deleted. Returns true if the mesh was split.
+bool MeshSplitter :: SplitMesh(unsigned int a, aiMesh* in_mesh,
+	std::vector<std::pair<aiMesh*, unsigned int> >& source_mesh_map, Stats& stats)
+{
 	if (in_mesh->mNumVertices <= LIMIT)	{
 		source_mesh_map.push_back(std::make_pair(in_mesh,a));
-		return;
+		return false;
 	}
 
 	// build a per-vertex weight list if necessary
 	VertexWeightTable* avPerVertexWeights = ComputeVertexBoneWeightTable(in_mesh);
 
+	// the order in which faces are distributed to the parts
+	std::vector<unsigned int> face_order;
+	if (locality_aware) {
+		ComputeLocalFaceOrder(in_mesh, LIMIT, face_order);
+	}
+
+	std::vector<size_t> cache_stamp;
+	stats.split_meshes++;
+	stats.vertices_in += in_mesh->mNumVertices;
+	stats.triangles_in += CountTriangles(in_mesh);
+	stats.cache_misses_in += CountCacheMisses(in_mesh, VERTEX_CACHE_SIZE, cache_stamp);
+
 	// we need to split this mesh into sub meshes. Estimate submesh size
 	const unsigned int sub_meshes = (in_mesh->mNumVertices / LIMIT) + 1;
 
@@ -122,11 +566,22 @@ void MeshSplitter :: SplitMesh(unsigned int a, aiMesh* in_mesh,
 	std::vector<unsigned int> was_copied_to;
 	was_copied_to.resize(in_mesh->mNumVertices,WAS_NOT_COPIED);
 
+	// the entries of was_copied_to set for the current submesh, so that it
+	// can be cleared in time proportional to the submesh size
+	std::vector<unsigned int> copied;
+	copied.reserve(LIMIT);
+
 	// Try to find a good estimate for the number of output faces
 	// per mesh. Add 12.5% as buffer
 	unsigned int size_estimated = in_mesh->mNumFaces / sub_meshes;
 	size_estimated += size_estimated / 8;
 
+	// a face with more indices than the limit gets a part of its own, which has to hold all of them
+	unsigned int capacity = LIMIT;
+	for (unsigned int f = 0; f < in_mesh->mNumFaces;++f) {
+		capacity = std::max(capacity, in_mesh->mFaces[f].mNumIndices);
+	}
+
 	// now generate all submeshes
 	unsigned int base = 0;
 	while (true) {
@@ -145,52 +600,55 @@ void MeshSplitter :: SplitMesh(unsigned int a, aiMesh* in_mesh,
 		}
 
 		// clear the temporary helper array
-		if (base)	{
-			std::fill(was_copied_to.begin(), was_copied_to.end(), WAS_NOT_COPIED);
+		for (std::vector<unsigned int>::const_iterator it = copied.begin(), end = copied.end(); it != end;++it) {
+			was_copied_to[*it] = WAS_NOT_COPIED;
 		}
+		copied.clear();
 
 		std::vector<aiFace> vFaces;
 
 		// reserve enough storage for most cases
 		if (in_mesh->HasPositions()) {
-			out_mesh->mVertices = new aiVector3D[out_vertex_index];
+			out_mesh->mVertices = new aiVector3D[capacity];
 		}
 
 		if (in_mesh->HasNormals()) {
-			out_mesh->mNormals = new aiVector3D[out_vertex_index];
+			out_mesh->mNormals = new aiVector3D[capacity];
 		}
 
 		if (in_mesh->HasTangentsAndBitangents())	{
-			out_mesh->mTangents = new aiVector3D[out_vertex_index];
-			out_mesh->mBitangents = new aiVector3D[out_vertex_index];
+			out_mesh->mTangents = new aiVector3D[capacity];
+			out_mesh->mBitangents = new aiVector3D[capacity];
 		}
 
 		for (unsigned int c = 0; in_mesh->HasVertexColors(c);++c)	{
-			out_mesh->mColors[c] = new aiColor4D[out_vertex_index];
+			out_mesh->mColors[c] = new aiColor4D[capacity];
 		}
 
 		for (unsigned int c = 0; in_mesh->HasTextureCoords(c);++c)	{
 			out_mesh->mNumUVComponents[c] = in_mesh->mNumUVComponents[c];
-			out_mesh->mTextureCoords[c] = new aiVector3D[out_vertex_index];
+			out_mesh->mTextureCoords[c] = new aiVector3D[capacity];
 		}
 		vFaces.reserve(size_estimated);
 
 		// (we will also need to copy the array of indices)
 		while (base < in_mesh->mNumFaces) {
-			const unsigned int iNumIndices = in_mesh->mFaces[base].mNumIndices;
+			const aiFace& in_face = in_mesh->mFaces[face_order.empty() ? base : face_order[base]];
+			const unsigned int iNumIndices = in_face.mNumIndices;
 
 			// doesn't catch degenerates but is quite fast
 			unsigned int iNeed = 0;
 			for (unsigned int v = 0; v < iNumIndices;++v)	{
-				unsigned int index = in_mesh->mFaces[base].mIndices[v];
+				unsigned int index = in_face.mIndices[v];
 
 				// check whether we do already have this vertex
 				if (WAS_NOT_COPIED == was_copied_to[index])	{
 					iNeed++; 
 				}
 			}
-			if (out_mesh->mNumVertices + iNeed > out_vertex_index)	{
-				// don't use this face
+			if (out_mesh->mNumVertices + iNeed > out_vertex_index && out_mesh->mNumVertices)	{
+				// don't use this face. The first face of a part is always taken, otherwise a
+				// face larger than the limit would never make it into any part.
 				break;
 			}
 
@@ -219,7 +677,7 @@ void MeshSplitter :: SplitMesh(unsigned int a, aiMesh* in_mesh,
 
 			// and copy the contents of the old array, offset them by current base
 			for (unsigned int v = 0; v < iNumIndices;++v) {
-				const unsigned int index = in_mesh->mFaces[base].mIndices[v];
+				const unsigned int index = in_face.mIndices[v];
 
 				// check whether we do already have this vertex
 				if (WAS_NOT_COPIED != was_copied_to[index]) {
@@ -256,7 +714,7 @@ void MeshSplitter :: SplitMesh(unsigned int a, aiMesh* in_mesh,
 				// check whether we have bone weights assigned to this vertex
 				rFace.mIndices[v] = out_mesh->mNumVertices;
 				if (avPerVertexWeights) {
-					VertexWeightTable& table = avPerVertexWeights[ out_mesh->mNumVertices ];
+					VertexWeightTable& table = avPerVertexWeights[ index ];
 					for (VertexWeightTable::const_iterator iter = table.begin(), end = table.end(); iter != end;++iter) {
 						// allocate the bone weight array if necessary and store it in the mBones field (HACK!)
 						BoneWeightList* weight_list = reinterpret_cast<BoneWeightList*>(out_mesh->mBones[(*iter).first]);
@@ -269,10 +727,11 @@ void MeshSplitter :: SplitMesh(unsigned int a, aiMesh* in_mesh,
 				}
 
 				was_copied_to[index] = out_mesh->mNumVertices;
+				copied.push_back(index);
 				out_mesh->mNumVertices++;
 			}
 			base++;
-			if(out_mesh->mNumVertices == out_vertex_index) {
+			if(out_mesh->mNumVertices >= out_vertex_index) {
 				// break here. The face is only added if it was complete
 				break;
 			}
@@ -311,6 +770,15 @@ void MeshSplitter :: SplitMesh(unsigned int a, aiMesh* in_mesh,
 			out_mesh->mFaces[p] = vFaces[p];
 		}
 
+		if (optimize_vertex_cache && out_mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE) {
+			OptimizeVertexCache(out_mesh, VERTEX_CACHE_SIZE);
+		}
+
+		stats.parts++;
+		stats.vertices_out += out_mesh->mNumVertices;
+		stats.triangles_out += CountTriangles(out_mesh);
+		stats.cache_misses_out += CountCacheMisses(out_mesh, VERTEX_CACHE_SIZE, cache_stamp);
+
 		// add the newly created mesh to the list
 		source_mesh_map.push_back(std::make_pair(out_mesh,a));
 
@@ -321,7 +789,5 @@ void MeshSplitter :: SplitMesh(unsigned int a, aiMesh* in_mesh,
 
 	// delete the per-vertex weight list again
 	delete[] avPerVertexWeights;
-
-	// now delete the old mesh data
-	delete in_mesh;
+	return true;
 }
@@ -15,6 +15,7 @@ Licensed under a 3-clause BSD license. See the LICENSE file for more information
 // ----------------------------------------------------------------------------
 
 #include <vector>
+#include <cstddef>
 
 struct aiScene;
 struct aiMesh;
@@ -27,6 +28,52 @@ struct aiNode;
 class MeshSplitter 
 {
 
+public:
+
+	// ---------------------------------------------------------------------------
+	/** Statistics on the meshes which were split by the last call to
+	 *  Execute() or ExecuteShared(). Meshes below the limit are not counted.
+	 *  Cache figures assume a FIFO post-transform vertex cache of 16 entries.
+	 */
+	struct Stats
+	{
+		Stats()
+			: split_meshes()
+			, parts()
+			, vertices_in()
+			, vertices_out()
+			, triangles_in()
+			, triangles_out()
+			, cache_misses_in()
+			, cache_misses_out()
+		{}
+
+		Stats& operator += (const Stats& other);
+
+		// ratio of vertices added by duplicating vertices shared between parts
+		double GetDuplicationRatio() const;
+
+		// average cache miss ratio (misses per triangle) of the split meshes
+		double GetACMRBefore() const;
+
+		// average cache miss ratio of the parts they were split into
+		double GetACMRAfter() const;
+
+		unsigned int split_meshes, parts;
+		size_t vertices_in, vertices_out;
+		size_t triangles_in, triangles_out;
+		size_t cache_misses_in, cache_misses_out;
+	};
+
+public:
+
+	MeshSplitter()
+		: LIMIT(1 << 16)
+		, threads(1)
+		, locality_aware(false)
+		, optimize_vertex_cache(false)
+	{}
+
 public:
 	
 	void SetLimit(unsigned int l) {
@@ -37,6 +84,43 @@ public:
 		return LIMIT;
 	}
 
+	// maximum number of meshes to split concurrently. The result is
+	// the same regardless of the number of threads.
+	void SetThreads(unsigned int n) {
+		threads = n ? n : 1;
+	}
+
+	unsigned int GetThreads() const {
+		return threads;
+	}
+
+	// if set, meshes are split into parts which are grown over shared
+	// vertices, which keeps the parts compact and reduces the number of
+	// vertices duplicated between them. Otherwise parts are filled with
+	// faces in their original order.
+	void SetLocalityAware(bool b) {
+		locality_aware = b;
+	}
+
+	bool IsLocalityAware() const {
+		return locality_aware;
+	}
+
+	// if set, the triangles of every part are reordered for the
+	// post-transform vertex cache. Meshes which are not split are
+	// left alone.
+	void SetOptimizeVertexCache(bool b) {
+		optimize_vertex_cache = b;
+	}
+
+	bool IsOptimizeVertexCache() const {
+		return optimize_vertex_cache;
+	}
+
+	const Stats& GetStats() const {
+		return stats;
+	}
+
 public:
 
 	// -------------------------------------------------------------------
@@ -46,15 +130,40 @@ public:
 	 */
 	void Execute( aiScene* pScene);
 
+	// -------------------------------------------------------------------
+	/** Executes the post processing step on a scene whose meshes and nodes
+	 * are shared with another scene, typically a shallow copy of a const
+	 * scene. Meshes that need to be split are replaced in the mesh list by
+	 * newly allocated meshes but otherwise left untouched. Nodes are never
+	 * modified, instead pScene->mRootNode is replaced by an updated copy of
+	 * the node hierarchy if any mesh was split.
+	 * @param pScene The scene to work at, its mMeshes array must be owned
+	 *   by the caller.
+	 * @return true if any mesh was split, i.e. the caller owns all meshes
+	 *   that are not in the original scene plus the new node hierarchy.
+	 */
+	bool ExecuteShared( aiScene* pScene);
+
 
 private:
 
-	void UpdateNode(aiNode* pcNode, const std::vector<std::pair<aiMesh*, unsigned int> >& source_mesh_map);
-	void SplitMesh (unsigned int index, aiMesh* mesh, std::vector<std::pair<aiMesh*, unsigned int> >& source_mesh_map);
+	void UpdateNode(aiNode* pcNode, const std::vector<unsigned int>& mesh_ranges);
+	aiNode* CopyNode(const aiNode* pcNode, aiNode* parent, const std::vector<unsigned int>& mesh_ranges);
+	void RemapMeshIndices(const aiNode* pcNode, const std::vector<unsigned int>& mesh_ranges, std::vector<unsigned int>& aiEntries);
+
+	bool SplitAll(aiScene* pScene, std::vector<std::pair<aiMesh*, unsigned int> >& source_mesh_map, std::vector<unsigned int>& mesh_ranges);
+	bool SplitMesh (unsigned int index, aiMesh* mesh, std::vector<std::pair<aiMesh*, unsigned int> >& source_mesh_map, Stats& stats);
 
 public:
 
 	unsigned int LIMIT;
+
+private:
+
+	unsigned int threads;
+	bool locality_aware;
+	bool optimize_vertex_cache;
+	Stats stats;
 };
 
 #endif // INCLUDED_MESH_SPLITTER
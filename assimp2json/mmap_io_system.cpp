@@ -0,0 +1,264 @@
+/*
+Assimp2Json
+Copyright (c) 2011, Alexander C. Gessler
+
+Licensed under a 3-clause BSD license. See the LICENSE file for more information.
+
+*/
+
+#include "mmap_io_system.h"
+
+#include <limits>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#endif
+
+// pages a sequential reader has left behind are released in steps of this many bytes
+#define RELEASE_GRANULARITY (1u << 24)
+
+// ------------------------------------------------------------------------------------------------
+MappedFileIOStream :: MappedFileIOStream(const char* data, size_t size, bool mapped, void* mapping_handle)
+	: data(data)
+	, size(size)
+	, mapped(mapped)
+	, mapping_handle(mapping_handle)
+	, pos()
+	, released()
+{
+}
+
+// ------------------------------------------------------------------------------------------------
+MappedFileIOStream :: ~MappedFileIOStream()
+{
+	if (!mapped) {
+		free(const_cast<char*>(data));
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle(static_cast<HANDLE>(mapping_handle));
+#else
+	munmap(const_cast<char*>(data), size);
+#endif
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t MappedFileIOStream :: Read(void* pvBuffer, size_t pSize, size_t pCount)
+{
+	if (!pSize) {
+		return 0;
+	}
+
+	// like fread(), only complete items are read
+	const size_t count = std::min(pCount, (size - pos) / pSize);
+
+	// copy in slices so that a reader which takes the whole file at once doesn't have all of
+	// it mapped in addition to its own copy
+	char* const out = static_cast<char*>(pvBuffer);
+	for (size_t done = 0, total = count * pSize; done < total; ) {
+		const size_t n = std::min(total - done, static_cast<size_t>(RELEASE_GRANULARITY));
+		memcpy(out + done, data + pos, n);
+		pos += n;
+		done += n;
+		ReleaseConsumedPages();
+	}
+	return count;
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t MappedFileIOStream :: Write(const void*, size_t, size_t)
+{
+	return 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+aiReturn MappedFileIOStream :: Seek(size_t pOffset, aiOrigin pOrigin)
+{
+	// negative offsets arrive wrapped around, so plain unsigned arithmetic gets them right
+	size_t target;
+	switch (pOrigin) {
+		case aiOrigin_SET:
+			target = pOffset;
+			break;
+		case aiOrigin_CUR:
+			target = pos + pOffset;
+			break;
+		case aiOrigin_END:
+			target = size + pOffset;
+			break;
+		default:
+			return aiReturn_FAILURE;
+	}
+	if (target > size) {
+		return aiReturn_FAILURE;
+	}
+
+	pos = target;
+	if (pos < released) {
+		// pages which are read again are released again once the reader has passed them
+		released = 0;
+	}
+	return aiReturn_SUCCESS;
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t MappedFileIOStream :: Tell() const
+{
+	return pos;
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t MappedFileIOStream :: FileSize() const
+{
+	return size;
+}
+
+// ------------------------------------------------------------------------------------------------
+void MappedFileIOStream :: Flush()
+{
+	// nothing to do, we never write
+}
+
+// ------------------------------------------------------------------------------------------------
+void MappedFileIOStream :: ReleaseConsumedPages()
+{
+#ifndef _WIN32
+	if (!mapped || pos < released + RELEASE_GRANULARITY) {
+		return;
+	}
+
+	// the mapping is private and never written to, so released pages are simply read from
+	// the file again should they be accessed after a backwards seek
+	const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	const size_t end = pos / page * page;
+	madvise(const_cast<char*>(data) + released, end - released, MADV_DONTNEED);
+	released = end;
+#endif
+}
+
+// ------------------------------------------------------------------------------------------------
+bool MappedFileIOSystem :: Exists( const char* pFile) const
+{
+	struct stat st;
+	return stat(pFile, &st) == 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+char MappedFileIOSystem :: getOsSeparator() const
+{
+#ifdef _WIN32
+	return '\\';
+#else
+	return '/';
+#endif
+}
+
+// ------------------------------------------------------------------------------------------------
+Assimp::IOStream* MappedFileIOSystem :: Open(const char* pFile, const char* pMode)
+{
+	if (strchr(pMode, 'w') || strchr(pMode, 'a') || strchr(pMode, '+')) {
+		return NULL;
+	}
+
+#ifdef _WIN32
+	const HANDLE file = CreateFileA(pFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file != INVALID_HANDLE_VALUE) {
+		LARGE_INTEGER file_size;
+		if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0 &&
+			static_cast<unsigned long long>(file_size.QuadPart) <= std::numeric_limits<size_t>::max()) {
+
+			// the mapping keeps the file open
+			const HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping) {
+				const void* const view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				if (view) {
+					CloseHandle(file);
+					return new MappedFileIOStream(static_cast<const char*>(view), static_cast<size_t>(file_size.QuadPart), true, mapping);
+				}
+				CloseHandle(mapping);
+			}
+		}
+		CloseHandle(file);
+	}
+#else
+	int fd;
+	do {
+		fd = open(pFile, O_RDONLY);
+	}
+	while (fd < 0 && errno == EINTR);
+
+	if (fd < 0) {
+		return NULL;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+		static_cast<unsigned long long>(st.st_size) <= std::numeric_limits<size_t>::max()) {
+
+		const size_t size = static_cast<size_t>(st.st_size);
+		void* const view = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view != MAP_FAILED) {
+			// the mapping stays valid after the descriptor is closed
+			close(fd);
+			madvise(view, size, MADV_SEQUENTIAL);
+			return new MappedFileIOStream(static_cast<const char*>(view), size, true);
+		}
+	}
+	close(fd);
+#endif
+
+	// empty files, pipes and anything else that can't be mapped is read into memory
+	FILE* const file = fopen(pFile, "rb");
+	if (!file) {
+		return NULL;
+	}
+
+	char* block = NULL;
+	size_t size = 0, capacity = 0;
+	for (;;) {
+		if (size == capacity) {
+			capacity = capacity ? capacity * 2 : 1u << 16;
+			char* const grown = static_cast<char*>(realloc(block, capacity));
+			if (!grown) {
+				free(block);
+				fclose(file);
+				return NULL;
+			}
+			block = grown;
+		}
+
+		const size_t n = fread(block + size, 1, capacity - size, file);
+		size += n;
+		if (n == 0) {
+			break;
+		}
+	}
+
+	const bool failed = ferror(file) != 0;
+	fclose(file);
+	if (failed) {
+		free(block);
+		return NULL;
+	}
+	return new MappedFileIOStream(block, size, false);
+}
+
+// ------------------------------------------------------------------------------------------------
+void MappedFileIOSystem :: Close( Assimp::IOStream* pFile)
+{
+	delete pFile;
+}
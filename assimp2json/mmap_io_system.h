@@ -0,0 +1,87 @@
+/*
+Assimp2Json
+Copyright (c) 2011, Alexander C. Gessler
+
+Licensed under a 3-clause BSD license. See the LICENSE file for more information.
+
+*/
+
+#ifndef INCLUDED_MMAP_IO_SYSTEM
+#define INCLUDED_MMAP_IO_SYSTEM
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+#include <cstddef>
+
+// ---------------------------------------------------------------------------
+/** Read-only Assimp::IOStream on a memory-mapped file. Read() copies
+ *  straight from the mapping into the caller's buffer. Buffered stdio
+ *  would first copy the data into its own buffer. The mapping is hinted
+ *  for sequential access, and pages which a sequential reader has left
+ *  behind are released again, so peak memory usage does not grow with the
+ *  file size.
+ */
+class MappedFileIOStream : public Assimp::IOStream
+{
+
+	friend class MappedFileIOSystem;
+
+protected:
+
+	// takes ownership of the mapping, or of the heap block if `mapped` is not set
+	MappedFileIOStream(const char* data, size_t size, bool mapped, void* mapping_handle = NULL);
+
+public:
+
+	~MappedFileIOStream();
+
+public:
+
+	size_t Read(void* pvBuffer, size_t pSize, size_t pCount);
+	size_t Write(const void* pvBuffer, size_t pSize, size_t pCount);
+	aiReturn Seek(size_t pOffset, aiOrigin pOrigin);
+	size_t Tell() const;
+	size_t FileSize() const;
+	void Flush();
+
+private:
+
+	// release the pages before the read position once enough of them have accumulated
+	void ReleaseConsumedPages();
+
+private:
+
+	// no copying
+	MappedFileIOStream(const MappedFileIOStream&);
+	MappedFileIOStream& operator=(const MappedFileIOStream&);
+
+private:
+	const char* const data;
+	const size_t size;
+	const bool mapped;
+	void* const mapping_handle;
+	size_t pos;
+	size_t released;
+};
+
+
+// ---------------------------------------------------------------------------
+/** Assimp::IOSystem which opens files through MappedFileIOStream. Files
+ *  which cannot be mapped, i.e. pipes, are read into memory instead.
+ *  Install it with Assimp::Importer::SetIOHandler(). Files can only be
+ *  opened for reading.
+ */
+class MappedFileIOSystem : public Assimp::IOSystem
+{
+
+public:
+
+	bool Exists( const char* pFile) const;
+	char getOsSeparator() const;
+
+	Assimp::IOStream* Open(const char* pFile, const char* pMode = "rb");
+	void Close( Assimp::IOStream* pFile);
+};
+
+#endif // INCLUDED_MMAP_IO_SYSTEM
@@ -0,0 +1,377 @@
+/*
+Assimp2Json
+Copyright (c) 2011, Alexander C. Gessler
+
+Licensed under a 3-clause BSD license. See the LICENSE file for more information.
+
+*/
+
+#include "number_format.h"
+
+#include <stdint.h>
+#include <cstring>
+
+// ----------------------------------------------------------------------------
+// Note: the Grisu2 implementation follows the structure of Milo Yip's
+// well-known dtoa implementation (as used in RapidJSON). It is generalized
+// to take the rounding boundaries of either single or double precision
+// numbers, so floats get the shortest string for *float* precision.
+// ----------------------------------------------------------------------------
+
+namespace {
+
+// ------------------------------------------------------------------------------------------------
+// "do it yourself" floating-point number, f * 2^e
+struct DiyFp
+{
+	DiyFp() {}
+	DiyFp(uint64_t f, int e) : f(f), e(e) {}
+
+	DiyFp operator-(const DiyFp& rhs) const {
+		return DiyFp(f - rhs.f, e);
+	}
+
+	// upper 64 bits of the 128 bit product, rounded
+	DiyFp operator*(const DiyFp& rhs) const {
+		const uint64_t M32 = 0xFFFFFFFFu;
+		const uint64_t a = f >> 32, b = f & M32, c = rhs.f >> 32, d = rhs.f & M32;
+		const uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+		uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32);
+		tmp += 1u << 31;
+		return DiyFp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), e + rhs.e + 64);
+	}
+
+	DiyFp Normalize() const {
+		DiyFp res = *this;
+		while (!(res.f & (1ULL << 63))) {
+			res.f <<= 1;
+			res.e--;
+		}
+		return res;
+	}
+
+	uint64_t f;
+	int e;
+};
+
+// ------------------------------------------------------------------------------------------------
+// Normalized 64 bit approximations of 10^k for k = -348, -340, ..., 340
+const uint64_t kCachedPowers_F[] = {
+	0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+	0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+	0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+	0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+	0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+	0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+	0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+	0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+	0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+	0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+	0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+	0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+	0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+	0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+	0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+	0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+	0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+	0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+	0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+	0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+	0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+	0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+	0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+	0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+	0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+	0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+	0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+	0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+	0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+const short kCachedPowers_E[] = {
+	-1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+	-954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+	-688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+	-422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+	-157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+	109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+	375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+	641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+	907, 933, 960, 986, 1013, 1039, 1066
+};
+
+const uint64_t kPow10[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+	1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+	100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+	1000000000000000000ULL, 10000000000000000000ULL
+};
+
+const char kDigitPairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+// ------------------------------------------------------------------------------------------------
+// Get a cached power of ten c_k such that the product with a number of binary exponent e
+// falls into the range that DigitGen() can process. K receives the decimal exponent of -k.
+DiyFp GetCachedPower(int e, int* K)
+{
+	const double dk = (-61 - e) * 0.30102999566398114 + 347;
+	int k = static_cast<int>(dk);
+	if (k != dk) {
+		k++;
+	}
+
+	const unsigned int index = static_cast<unsigned int>((k >> 3) + 1);
+	*K = -(-348 + static_cast<int>(index << 3));
+	return DiyFp(kCachedPowers_F[index], kCachedPowers_E[index]);
+}
+
+// ------------------------------------------------------------------------------------------------
+void GrisuRound(char* buffer, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
+{
+	while (rest < wp_w && delta - rest >= ten_kappa &&
+		(rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+		buffer[len - 1]--;
+		rest += ten_kappa;
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+int CountDecimalDigit32(uint32_t n)
+{
+	int count = 1;
+	for (uint32_t limit = 10; count < 10 && n >= limit; limit *= 10) {
+		++count;
+	}
+	return count;
+}
+
+// ------------------------------------------------------------------------------------------------
+void DigitGen(const DiyFp& W, const DiyFp& Mp, uint64_t delta, char* buffer, int* len, int* K)
+{
+	const DiyFp one(1ULL << -Mp.e, Mp.e);
+	const DiyFp wp_w = Mp - W;
+	uint32_t p1 = static_cast<uint32_t>(Mp.f >> -one.e);
+	uint64_t p2 = Mp.f & (one.f - 1);
+	int kappa = CountDecimalDigit32(p1);
+	*len = 0;
+
+	// integral part
+	while (kappa > 0) {
+		const uint32_t div = static_cast<uint32_t>(kPow10[kappa - 1]);
+		const uint32_t d = p1 / div;
+		p1 %= div;
+
+		if (d || *len) {
+			buffer[(*len)++] = static_cast<char>('0' + d);
+		}
+		kappa--;
+
+		const uint64_t tmp = (static_cast<uint64_t>(p1) << -one.e) + p2;
+		if (tmp <= delta) {
+			*K += kappa;
+			GrisuRound(buffer, *len, delta, tmp, kPow10[kappa] << -one.e, wp_w.f);
+			return;
+		}
+	}
+
+	// fractional part
+	for (;;) {
+		p2 *= 10;
+		delta *= 10;
+		const char d = static_cast<char>(p2 >> -one.e);
+		if (d || *len) {
+			buffer[(*len)++] = static_cast<char>('0' + d);
+		}
+		p2 &= one.f - 1;
+		kappa--;
+
+		if (p2 < delta) {
+			*K += kappa;
+			const int index = -kappa;
+			GrisuRound(buffer, *len, delta, p2, one.f, wp_w.f * (index < 20 ? kPow10[index] : 0));
+			return;
+		}
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+// Generate the digits of f * 2^e, a positive number. closer_lower_boundary is set if
+// the next smaller representable number is only half as far away as the next larger one.
+void Grisu2(uint64_t f, int e, bool closer_lower_boundary, char* buffer, int* len, int* K)
+{
+	// boundaries m-, m+ halfway to the neighbouring representable numbers
+	const DiyFp plus = DiyFp((f << 1) + 1, e - 1).Normalize();
+	DiyFp minus = closer_lower_boundary ? DiyFp((f << 2) - 1, e - 2) : DiyFp((f << 1) - 1, e - 1);
+	minus.f <<= minus.e - plus.e;
+	minus.e = plus.e;
+
+	const DiyFp c_mk = GetCachedPower(plus.e, K);
+	const DiyFp W = DiyFp(f, e).Normalize() * c_mk;
+	DiyFp Wp = plus * c_mk;
+	DiyFp Wm = minus * c_mk;
+	Wm.f++;
+	Wp.f--;
+	DigitGen(W, Wp, Wp.f - Wm.f, buffer, len, K);
+}
+
+// ------------------------------------------------------------------------------------------------
+char* WriteExponent(int K, char* out)
+{
+	*out++ = 'e';
+	if (K < 0) {
+		*out++ = '-';
+		K = -K;
+	}
+	else {
+		*out++ = '+';
+	}
+
+	if (K >= 100) {
+		*out++ = static_cast<char>('0' + K / 100);
+		K %= 100;
+		*out++ = static_cast<char>('0' + K / 10);
+	}
+	else if (K >= 10) {
+		*out++ = static_cast<char>('0' + K / 10);
+	}
+	*out++ = static_cast<char>('0' + K % 10);
+	return out;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Lay out the digits d1..dlen of 0.d1..dlen * 10^n in the style of ECMAScript's Number::toString,
+// except that exponential notation is also used for moderate exponents where it is shorter, e.g.
+// 1e+20 or 1e-5 (ties go to plain decimals). buffer holds the digits at entry and must be large
+// enough for the result.
+char* Prettify(char* buffer, int len, int n)
+{
+	// length of the exponential notation
+	const int K = n - 1 < 0 ? 1 - n : n - 1;
+	const int exponent_len = (len > 1 ? len + 1 : len) + 2 + (K >= 100 ? 3 : K >= 10 ? 2 : 1);
+
+	if (len <= n && n <= 21 && n <= exponent_len) {
+		// 1234e7 -> 12340000000
+		memset(buffer + len, '0', n - len);
+		return buffer + n;
+	}
+	else if (n < len && 0 < n && n <= 21) {
+		// 1234e-2 -> 12.34
+		memmove(buffer + n + 1, buffer + n, len - n);
+		buffer[n] = '.';
+		return buffer + len + 1;
+	}
+	else if (-6 < n && n <= 0 && len + 2 - n <= exponent_len) {
+		// 1234e-6 -> 0.001234
+		const int offset = 2 - n;
+		memmove(buffer + offset, buffer, len);
+		buffer[0] = '0';
+		buffer[1] = '.';
+		memset(buffer + 2, '0', offset - 2);
+		return buffer + len + offset;
+	}
+	else if (len == 1) {
+		// 1e30
+		return WriteExponent(n - 1, buffer + 1);
+	}
+
+	// 1234e30 -> 1.234e+33
+	memmove(buffer + 2, buffer + 1, len - 1);
+	buffer[1] = '.';
+	return WriteExponent(n - 1, buffer + len + 1);
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t FormatReal(bool negative, uint64_t f, int e, bool closer_lower_boundary, char* out)
+{
+	char* cur = out;
+	if (negative) {
+		*cur++ = '-';
+	}
+
+	if (!f) {
+		*cur++ = '0';
+		return static_cast<size_t>(cur - out);
+	}
+
+	int len, K;
+	Grisu2(f, e, closer_lower_boundary, cur, &len, &K);
+	return static_cast<size_t>(Prettify(cur, len, len + K) - out);
+}
+
+} // end anonymous namespace
+
+// ------------------------------------------------------------------------------------------------
+size_t FormatFloat(float value, char* out)
+{
+	uint32_t u;
+	memcpy(&u, &value, sizeof u);
+
+	const int biased_e = static_cast<int>((u >> 23) & 0xFF);
+	const uint32_t significand = u & 0x7FFFFF;
+
+	// denormals share the exponent of the smallest normal number
+	const uint64_t f = biased_e ? significand | 0x800000 : significand;
+	const int e = (biased_e ? biased_e : 1) - 150;
+	return FormatReal((u >> 31) != 0, f, e, !significand && biased_e > 1, out);
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t FormatDouble(double value, char* out)
+{
+	uint64_t u;
+	memcpy(&u, &value, sizeof u);
+
+	const int biased_e = static_cast<int>((u >> 52) & 0x7FF);
+	const uint64_t significand = u & 0xFFFFFFFFFFFFFULL;
+
+	const uint64_t f = biased_e ? significand | 0x10000000000000ULL : significand;
+	const int e = (biased_e ? biased_e : 1) - 1075;
+	return FormatReal((u >> 63) != 0, f, e, !significand && biased_e > 1, out);
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t FormatUInt(unsigned int u, char* out)
+{
+	// generate digits back to front, two at a time
+	char tmp[NUMBER_FORMAT_MAX_INT_CHARS];
+	char* cur = tmp + sizeof tmp;
+
+	while (u >= 100) {
+		const unsigned int i = (u % 100) * 2;
+		u /= 100;
+		*--cur = kDigitPairs[i + 1];
+		*--cur = kDigitPairs[i];
+	}
+
+	if (u >= 10) {
+		*--cur = kDigitPairs[u * 2 + 1];
+		*--cur = kDigitPairs[u * 2];
+	}
+	else {
+		*--cur = static_cast<char>('0' + u);
+	}
+
+	const size_t len = static_cast<size_t>(tmp + sizeof tmp - cur);
+	memcpy(out, cur, len);
+	return len;
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t FormatInt(int i, char* out)
+{
+	if (i < 0) {
+		*out = '-';
+		return FormatUInt(0u - static_cast<unsigned int>(i), out + 1) + 1;
+	}
+	return FormatUInt(static_cast<unsigned int>(i), out);
+}
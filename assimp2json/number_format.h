@@ -0,0 +1,62 @@
+/*
+Assimp2Json
+Copyright (c) 2011, Alexander C. Gessler
+
+Licensed under a 3-clause BSD license. See the LICENSE file for more information.
+
+*/
+
+#ifndef INCLUDED_NUMBER_FORMAT
+#define INCLUDED_NUMBER_FORMAT
+
+// ----------------------------------------------------------------------------
+// Locale-independent number to text conversion for the JSON writer.
+//
+// Integers are written two digits at a time from a lookup table.
+//
+// Floating-point numbers are formatted using Florian Loitsch's Grisu2
+// algorithm ("Printing Floating-Point Numbers Quickly and Accurately with
+// Integers", PLDI 2010). The output always reads back to the exact same
+// binary value, and it is the shortest such string in all but a tiny
+// fraction of cases.
+// ----------------------------------------------------------------------------
+
+#include <cstddef>
+
+// upper bound for the number of characters written by FormatFloat() and FormatDouble()
+#define NUMBER_FORMAT_MAX_REAL_CHARS 32
+
+// upper bound for the number of characters written by FormatUInt() and FormatInt()
+#define NUMBER_FORMAT_MAX_INT_CHARS 11
+
+// ---------------------------------------------------------------------------
+/** Writes the decimal representation of an unsigned integer.
+ *
+ *  @param u Number to be written.
+ *  @param out Output buffer, must hold at least NUMBER_FORMAT_MAX_INT_CHARS
+ *    characters. The result is not zero-terminated.
+ *  @return Number of characters written. */
+size_t FormatUInt(unsigned int u, char* out);
+
+// ---------------------------------------------------------------------------
+/** Signed counterpart to FormatUInt() */
+size_t FormatInt(int i, char* out);
+
+// ---------------------------------------------------------------------------
+/** Writes the shortest decimal representation of a finite float that reads
+ *  back to the identical value. The number is written in plain decimals or
+ *  in exponential notation (1e-7, 1.5e+21), whichever is shorter. Ties go
+ *  to plain decimals, so this matches ECMAScript's Number.prototype.toString
+ *  except for round numbers such as 1e+4 or 1e-5.
+ *
+ *  @param f Number to be written, must not be Inf or NaN.
+ *  @param out Output buffer, must hold at least NUMBER_FORMAT_MAX_REAL_CHARS
+ *    characters. The result is not zero-terminated.
+ *  @return Number of characters written. */
+size_t FormatFloat(float f, char* out);
+
+// ---------------------------------------------------------------------------
+/** Double-precision counterpart to FormatFloat() */
+size_t FormatDouble(double d, char* out);
+
+#endif // INCLUDED_NUMBER_FORMAT
@@ -0,0 +1,288 @@
+/*
+Assimp2Json
+Copyright (c) 2011, Alexander C. Gessler
+
+Licensed under a 3-clause BSD license. See the LICENSE file for more information.
+
+*/
+
+#include "server.h"
+#include "fd_io_system.h"
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#	include <io.h>
+#	define fd_read(fd, buf, n) _read(fd, buf, static_cast<unsigned int>(n))
+#else
+#	include <unistd.h>
+#	include <signal.h>
+#	include <sys/socket.h>
+#	include <sys/un.h>
+#	define fd_read read
+#endif
+
+// requests longer than this are refused and the connection is closed
+#define MAX_REQUEST_LENGTH (1 << 16)
+
+namespace {
+
+// reads lines from a file descriptor without reading ahead of the current request more
+// than one buffer's worth, which is kept for the next line
+class LineReader
+{
+
+public:
+
+	explicit LineReader(int fd)
+		: fd(fd)
+	{}
+
+public:
+
+	// read the next line without its terminating \n (and \r). Returns false at the end
+	// of input, on errors and for overly long lines.
+	bool ReadLine(std::string& line) {
+		for(;;) {
+			const std::string::size_type eol = buffer.find('\n');
+			if(eol != std::string::npos) {
+				line.assign(buffer, 0, eol);
+				buffer.erase(0, eol + 1);
+				if(!line.empty() && line[line.length() - 1] == '\r') {
+					line.erase(line.length() - 1);
+				}
+				return true;
+			}
+			if(buffer.length() > MAX_REQUEST_LENGTH) {
+				return false;
+			}
+
+			char tmp[4096];
+			const long n = static_cast<long>(fd_read(fd, tmp, sizeof tmp));
+			if(n < 0 && errno == EINTR) {
+				continue;
+			}
+			if(n <= 0) {
+				return false;
+			}
+			buffer.append(tmp, static_cast<size_t>(n));
+		}
+	}
+
+private:
+	const int fd;
+	std::string buffer;
+};
+
+// answer all requests on one connection, until it is closed or fails
+void ServeConnection(int in, int out, unsigned int worker, const RequestHandler& handler)
+{
+	LineReader reader(in);
+	std::string request;
+	while(reader.ReadLine(request)) {
+		if(request.find_first_not_of(" \t") == std::string::npos) {
+			continue;
+		}
+
+		ServerResponse response(out);
+		handler(worker, request, response);
+		if(!response.IsDone()) {
+			response.Error("no response");
+		}
+		if(response.Failed()) {
+			return;
+		}
+	}
+}
+
+} // !anon
+
+
+// frames the document in chunks of <length>\n<data>
+class ServerResponse::ChunkSink : public Assimp2JsonSink
+{
+
+public:
+
+	explicit ChunkSink(ServerResponse& response)
+		: response(response)
+	{}
+
+public:
+
+	bool Write(const char* data, size_t size) {
+		if(!size) {
+			return true;
+		}
+
+		std::ostringstream header;
+		header << size << '\n';
+		const std::string h = header.str();
+		return response.Send(h.data(), h.length()) && response.Send(data, size);
+	}
+
+private:
+	ServerResponse& response;
+};
+
+
+// ------------------------------------------------------------------------------------------------
+ServerResponse :: ServerResponse(int fd)
+	: fd(fd)
+	, state(state_new)
+	, failed()
+	, sink()
+{
+}
+
+// ------------------------------------------------------------------------------------------------
+ServerResponse :: ~ServerResponse()
+{
+	delete sink;
+}
+
+// ------------------------------------------------------------------------------------------------
+bool ServerResponse :: Send(const char* data, size_t size)
+{
+	if(failed) {
+		return false;
+	}
+
+	FileDescriptorIOStream stream(fd);
+	failed = stream.Write(data, 1, size) != size;
+	return !failed;
+}
+
+// ------------------------------------------------------------------------------------------------
+void ServerResponse :: Error(const std::string& message)
+{
+	if(state == state_done) {
+		return;
+	}
+
+	// the message must not break the framing
+	std::string line = "error " + message;
+	std::replace(line.begin(), line.end(), '\n', ' ');
+	line += '\n';
+
+	Send(line.data(), line.length());
+	state = state_done;
+}
+
+// ------------------------------------------------------------------------------------------------
+Assimp2JsonSink& ServerResponse :: Begin()
+{
+	if(state == state_new) {
+		Send("ok\n", 3);
+		state = state_begun;
+		sink = new ChunkSink(*this);
+	}
+	return *sink;
+}
+
+// ------------------------------------------------------------------------------------------------
+void ServerResponse :: End()
+{
+	if(state == state_begun) {
+		Send("0\n", 2);
+		state = state_done;
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+int ServeStdio(const RequestHandler& handler)
+{
+	// responses go to stdout as well, so keep anything else away from it
+	std::cout.flush();
+
+#ifndef _WIN32
+	// a client which closes its end of the pipe gets the write failing instead of killing
+	// the server mid-response
+	signal(SIGPIPE, SIG_IGN);
+#endif
+	ServeConnection(0, 1, 0, handler);
+	return 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+int ServeSocket(const char* path, unsigned int workers, const RequestHandler& handler)
+{
+#ifdef _WIN32
+	std::cerr << "serving on a socket is not supported on this platform, use --serve -" << std::endl;
+	return -7;
+#else
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof addr.sun_path) {
+		std::cerr << "socket path too long: " << path << std::endl;
+		return -7;
+	}
+	strcpy(addr.sun_path, path);
+
+	const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listener < 0) {
+		std::cerr << "failure creating socket: " << strerror(errno) << std::endl;
+		return -7;
+	}
+
+	unlink(path);
+	if(bind(listener, reinterpret_cast<const sockaddr*>(&addr), sizeof addr) < 0 || listen(listener, 64) < 0) {
+		std::cerr << "failure listening on " << path << ": " << strerror(errno) << std::endl;
+		close(listener);
+		return -7;
+	}
+
+	// clients which go away before their response is complete must not take the server with them
+	signal(SIGPIPE, SIG_IGN);
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::deque<int> connections;
+
+	auto worker = [&](unsigned int index) {
+		for(;;) {
+			int fd;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cond.wait(lock, [&]() { return !connections.empty(); });
+				fd = connections.front();
+				connections.pop_front();
+			}
+			ServeConnection(fd, fd, index, handler);
+			close(fd);
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for(unsigned int i = 0; i < workers; ++i) {
+		pool.push_back(std::thread(worker, i));
+	}
+
+	for(;;) {
+		const int fd = accept(listener, NULL, NULL);
+		if(fd < 0) {
+			if(errno != EINTR && errno != ECONNABORTED) {
+				// i.e. out of file descriptors, give the workers a chance to close some
+				std::cerr << "failure accepting connection: " << strerror(errno) << std::endl;
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		connections.push_back(fd);
+		cond.notify_one();
+	}
+#endif
+}
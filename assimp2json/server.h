@@ -0,0 +1,104 @@
+/*
+Assimp2Json
+Copyright (c) 2011, Alexander C. Gessler
+
+Licensed under a 3-clause BSD license. See the LICENSE file for more information.
+
+*/
+
+#ifndef INCLUDED_SERVER
+#define INCLUDED_SERVER
+
+// ----------------------------------------------------------------------------
+// Request loop for `assimp2json --serve`. Clients send one request per line
+// and receive one response per request, in order:
+//
+//   request:   [flags] input\n
+//   response:  error <message>\n
+//          or  ok\n, followed by chunks of the form <length>\n<length bytes>
+//              and a final 0\n
+//
+// If a conversion fails after its `ok` line was sent, `error <message>\n`
+// takes the place of the final 0\n. A client may send any number of
+// requests over one connection.
+// ----------------------------------------------------------------------------
+
+#include <string>
+#include <functional>
+
+#include "assimp2json.h"
+
+// ---------------------------------------------------------------------------
+/** Response to a single request. Either call Error(), or Begin(), write the
+ *  document to the sink it returns and then call End() or Error().
+ */
+class ServerResponse
+{
+
+public:
+
+	explicit ServerResponse(int fd);
+	~ServerResponse();
+
+public:
+
+	// reject the request, or abort the document if it was already begun
+	void Error(const std::string& message);
+
+	// accept the request, the document is then written to the returned sink
+	Assimp2JsonSink& Begin();
+
+	// complete the document
+	void End();
+
+	// true once a response was sent completely
+	bool IsDone() const {
+		return state == state_done;
+	}
+
+	// true if the connection failed, no further requests can be answered on it
+	bool Failed() const {
+		return failed;
+	}
+
+private:
+
+	bool Send(const char* data, size_t size);
+
+	class ChunkSink;
+	friend class ChunkSink;
+
+private:
+
+	// no copying
+	ServerResponse(const ServerResponse&);
+	ServerResponse& operator=(const ServerResponse&);
+
+private:
+	const int fd;
+	enum { state_new, state_begun, state_done } state;
+	bool failed;
+	ChunkSink* sink;
+};
+
+
+// handles one request line. `worker` identifies the calling thread, from 0 to the number of
+// workers - 1, so that handlers can keep expensive objects per worker and reuse them.
+typedef std::function<void(unsigned int worker, const std::string& request, ServerResponse& response)> RequestHandler;
+
+// ---------------------------------------------------------------------------
+/** Serves requests from stdin with responses on stdout until stdin is
+ *  closed, on the calling thread.
+ *  @return 0, or non-zero if stdout failed. */
+int ServeStdio(const RequestHandler& handler);
+
+// ---------------------------------------------------------------------------
+/** Serves requests on a Unix domain socket at `path`, which is replaced if
+ *  it already exists. Each connection is served by one of `workers`
+ *  threads, so up to that many requests are handled concurrently.
+ *  Not available on Windows.
+ *  @return Non-zero if the socket could not be set up, otherwise the
+ *    function does not return. */
+int ServeSocket(const char* path, unsigned int workers, const RequestHandler& handler);
+
+#endif // INCLUDED_SERVER
@@ -0,0 +1,270 @@
+/*
+Assimp2Json
+Copyright (c) 2011, Alexander C. Gessler
+
+Licensed under a 3-clause BSD license. See the LICENSE file for more information.
+
+*/
+
+#include "stats.h"
+
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	include <windows.h>
+#	include <psapi.h>
+#else
+#	include <sys/resource.h>
+#	include <unistd.h>
+#	ifdef __APPLE__
+#		include <mach/mach.h>
+#	endif
+#endif
+
+namespace {
+
+ConversionStats::AllocationCounter allocation_counter = NULL;
+thread_local ConversionStats* current = NULL;
+
+// ------------------------------------------------------------------------------------------------
+double CpuTimeMs()
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+		return 0.;
+	}
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return (k.QuadPart + u.QuadPart) * 1e-4;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage)) {
+		return 0.;
+	}
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 +
+		(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-3;
+#endif
+}
+
+// ------------------------------------------------------------------------------------------------
+std::string EscapeJSON(const std::string& s)
+{
+	std::string out;
+	for (std::string::const_iterator it = s.begin(); it != s.end(); ++it) {
+		const unsigned char c = static_cast<unsigned char>(*it);
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += static_cast<char>(c);
+		}
+		else if (c < 0x20) {
+			char buf[8];
+			sprintf(buf, "\\u%04x", c);
+			out += buf;
+		}
+		else {
+			out += static_cast<char>(c);
+		}
+	}
+	return out;
+}
+
+} // !anon
+
+// ------------------------------------------------------------------------------------------------
+ConversionStats::Sample ConversionStats :: Now()
+{
+	Sample s;
+	s.wall = std::chrono::steady_clock::now();
+	s.cpu_ms = CpuTimeMs();
+	s.allocations = s.allocated_bytes = 0;
+	if (allocation_counter) {
+		allocation_counter(s.allocations, s.allocated_bytes);
+	}
+	return s;
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t ConversionStats :: GetPeakRSS()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof counters)) {
+		return 0;
+	}
+	return counters.PeakWorkingSetSize;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage)) {
+		return 0;
+	}
+#	ifdef __APPLE__
+	return static_cast<size_t>(usage.ru_maxrss);
+#	else
+	return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#	endif
+#endif
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t ConversionStats :: GetCurrentRSS()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof counters)) {
+		return 0;
+	}
+	return counters.WorkingSetSize;
+#elif defined(__APPLE__)
+	mach_task_basic_info info;
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+	if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) {
+		return 0;
+	}
+	return static_cast<size_t>(info.resident_size);
+#else
+	// the second field of statm is the number of resident pages
+	FILE* const statm = fopen("/proc/self/statm", "r");
+	if (!statm) {
+		return 0;
+	}
+	unsigned long size = 0, resident = 0;
+	const int fields = fscanf(statm, "%lu %lu", &size, &resident);
+	fclose(statm);
+	if (fields != 2) {
+		return 0;
+	}
+	return static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+// ------------------------------------------------------------------------------------------------
+void ConversionStats :: SetAllocationCounter(AllocationCounter counter)
+{
+	allocation_counter = counter;
+}
+
+// ------------------------------------------------------------------------------------------------
+ConversionStats* ConversionStats :: GetCurrent()
+{
+	return current;
+}
+
+// ------------------------------------------------------------------------------------------------
+void ConversionStats :: SetCurrent(ConversionStats* stats)
+{
+	current = stats;
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t ConversionStats :: BeginPhase(const char* name, Sample& start)
+{
+	Phase phase = Phase();
+	phase.name = name;
+	phases.push_back(phase);
+
+	start = Now();
+	return phases.size() - 1;
+}
+
+// ------------------------------------------------------------------------------------------------
+void ConversionStats :: EndPhase(size_t index, const Sample& start, size_t bytes)
+{
+	const Sample end = Now();
+
+	Phase& phase = phases[index];
+	phase.wall_ms = std::chrono::duration<double, std::milli>(end.wall - start.wall).count();
+	phase.cpu_ms = end.cpu_ms - start.cpu_ms;
+	phase.allocations = end.allocations - start.allocations;
+	phase.allocated_bytes = end.allocated_bytes - start.allocated_bytes;
+	phase.peak_rss_bytes = GetPeakRSS();
+	phase.bytes = bytes;
+}
+
+// ------------------------------------------------------------------------------------------------
+void ConversionStats :: AddCounter(const char* name, double value)
+{
+	counters.push_back(std::make_pair(std::string(name), value));
+}
+
+// ------------------------------------------------------------------------------------------------
+void ConversionStats :: WriteText(std::ostream& out) const
+{
+	const double mb = 1. / (1 << 20);
+
+	std::ostringstream s;
+	s << std::fixed << std::setprecision(1);
+	if (!file.empty()) {
+		s << file << ":\n";
+	}
+
+	s << std::left << std::setw(28) << "phase" << std::right
+		<< std::setw(11) << "wall ms"
+		<< std::setw(11) << "cpu ms"
+		<< std::setw(11) << "allocs"
+		<< std::setw(11) << "alloc MB"
+		<< std::setw(11) << "peak MB"
+		<< std::setw(11) << "output MB" << "\n";
+
+	for (std::vector<Phase>::const_iterator it = phases.begin(); it != phases.end(); ++it) {
+		const Phase& p = *it;
+
+		// indent sub-phases by their depth
+		std::string name(2 * static_cast<size_t>(std::count(p.name.begin(), p.name.end(), '.')), ' ');
+		name += p.name.substr(p.name.find_last_of('.') + 1);
+
+		s << std::left << std::setw(28) << name << std::right
+			<< std::setw(11) << p.wall_ms
+			<< std::setw(11) << p.cpu_ms
+			<< std::setw(11) << p.allocations
+			<< std::setw(11) << p.allocated_bytes * mb
+			<< std::setw(11) << p.peak_rss_bytes * mb;
+		if (p.bytes) {
+			s << std::setw(11) << p.bytes * mb;
+		}
+		s << "\n";
+	}
+
+	s << std::setprecision(3);
+	for (std::vector<std::pair<std::string, double> >::const_iterator it = counters.begin(); it != counters.end(); ++it) {
+		s << std::left << std::setw(28) << (*it).first << std::right << std::setw(11) << (*it).second << "\n";
+	}
+	s << std::left << std::setw(28) << "peak RSS MB" << std::right << std::setw(11) << GetPeakRSS() * mb << "\n";
+
+	out << s.str();
+}
+
+// ------------------------------------------------------------------------------------------------
+void ConversionStats :: WriteJSON(std::ostream& out) const
+{
+	std::ostringstream s;
+	s << std::fixed << std::setprecision(3);
+
+	s << "{\"file\":\"" << EscapeJSON(file) << "\",\"phases\":[";
+	for (std::vector<Phase>::const_iterator it = phases.begin(); it != phases.end(); ++it) {
+		const Phase& p = *it;
+		s << (it == phases.begin() ? "" : ",")
+			<< "{\"name\":\"" << EscapeJSON(p.name) << "\""
+			<< ",\"wall_ms\":" << p.wall_ms
+			<< ",\"cpu_ms\":" << p.cpu_ms
+			<< ",\"allocations\":" << p.allocations
+			<< ",\"allocated_bytes\":" << p.allocated_bytes
+			<< ",\"peak_rss_bytes\":" << p.peak_rss_bytes
+			<< ",\"bytes\":" << p.bytes << "}";
+	}
+
+	s << "],\"counters\":{";
+	for (std::vector<std::pair<std::string, double> >::const_iterator it = counters.begin(); it != counters.end(); ++it) {
+		s << (it == counters.begin() ? "" : ",") << "\"" << EscapeJSON((*it).first) << "\":" << (*it).second;
+	}
+	s << "},\"peak_rss_bytes\":" << GetPeakRSS() << "}\n";
+
+	out << s.str();
+}
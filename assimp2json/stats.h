@@ -0,0 +1,151 @@
+/*
+Assimp2Json
+Copyright (c) 2011, Alexander C. Gessler
+
+Licensed under a 3-clause BSD license. See the LICENSE file for more information.
+
+*/
+
+#ifndef INCLUDED_STATS
+#define INCLUDED_STATS
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ostream>
+#include <cstddef>
+
+// ---------------------------------------------------------------------------
+/** Timing, memory and size figures of a single conversion, collected for
+ *  `assimp2json --stats`.
+ *
+ *  The conversion is divided into named phases, such as "import" or
+ *  "export.write.meshes". A dot in a name marks a sub-phase. CPU time,
+ *  allocations and peak RSS are process-wide figures, so they include all
+ *  threads. In batch mode they include other conversions running at the
+ *  same time.
+ */
+class ConversionStats
+{
+
+public:
+
+	struct Phase
+	{
+		std::string name;
+		double wall_ms, cpu_ms;
+
+		// number and total size of allocations made during the phase (0 if not counted)
+		size_t allocations, allocated_bytes;
+
+		// peak resident set size of the process at the end of the phase
+		size_t peak_rss_bytes;
+
+		// bytes of output written during the phase (0 if not applicable)
+		size_t bytes;
+	};
+
+	// process-wide counters at some point in time
+	struct Sample
+	{
+		std::chrono::steady_clock::time_point wall;
+		double cpu_ms;
+		size_t allocations, allocated_bytes;
+	};
+
+	// function to read the total number and size of all allocations so far
+	typedef void (*AllocationCounter)(size_t& allocations, size_t& bytes);
+
+public:
+
+	explicit ConversionStats(const std::string& file = std::string())
+		: file(file)
+	{}
+
+public:
+
+	// begin a phase and return its index for EndPhase(). Phases are reported
+	// in the order in which they begin.
+	size_t BeginPhase(const char* name, Sample& start);
+	void EndPhase(size_t index, const Sample& start, size_t bytes = 0);
+
+	// a named figure which is not a phase, e.g. the number of meshes split
+	void AddCounter(const char* name, double value);
+
+	// human-readable table
+	void WriteText(std::ostream& out) const;
+
+	// one line of JSON
+	void WriteJSON(std::ostream& out) const;
+
+	const std::vector<Phase>& GetPhases() const {
+		return phases;
+	}
+
+public:
+
+	static Sample Now();
+
+	// peak resident set size of the process so far, 0 if unknown
+	static size_t GetPeakRSS();
+
+	// current resident set size of the process, 0 if unknown
+	static size_t GetCurrentRSS();
+
+	// allocations are only counted if the application installs a counter
+	static void SetAllocationCounter(AllocationCounter counter);
+
+	// the stats object conversions on the calling thread report to, NULL if none
+	static ConversionStats* GetCurrent();
+	static void SetCurrent(ConversionStats* stats);
+
+private:
+
+	std::string file;
+	std::vector<Phase> phases;
+	std::vector<std::pair<std::string, double> > counters;
+};
+
+// ---------------------------------------------------------------------------
+/** Records a phase from construction to destruction in the calling thread's
+ *  current ConversionStats, if there is one. */
+class StatsPhase
+{
+
+public:
+
+	explicit StatsPhase(const char* name)
+		: stats(ConversionStats::GetCurrent())
+		, index()
+		, bytes()
+	{
+		if (stats) {
+			index = stats->BeginPhase(name, start);
+		}
+	}
+
+	~StatsPhase()
+	{
+		if (stats) {
+			stats->EndPhase(index, start, bytes);
+		}
+	}
+
+	void SetBytes(size_t n) {
+		bytes = n;
+	}
+
+private:
+
+	// no copying
+	StatsPhase(const StatsPhase&);
+	StatsPhase& operator=(const StatsPhase&);
+
+private:
+
+	ConversionStats* const stats;
+	ConversionStats::Sample start;
+	size_t index, bytes;
+};
+
+#endif // INCLUDED_STATS
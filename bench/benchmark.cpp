@@ -0,0 +1,866 @@
+/*
+Assimp2Json
+Copyright (c) 2011, Alexander C. Gessler
+
+Licensed under a 3-clause BSD license. See the LICENSE file for more information.
+
+*/
+
+// ----------------------------------------------------------------------------
+// Benchmarks for assimp2json on synthetic scenes and on the sample files.
+//
+// usage: assimp2json_bench [--samples dir] [--output file] [--io-size MB]
+//                          [--compare baseline] [--tolerance percent] [filter]
+//
+// Only benchmarks whose name contains `filter` are run. Results are printed
+// one per line as
+//
+//   <benchmark> <metric> <value> <unit>
+//
+// so that runs of different versions can be compared line by line. With
+// --output, the same lines are also written to a file, which a later run
+// can be compared against with --compare. The comparison is printed on
+// stderr and the exit code is 1 if any time got slower or any throughput
+// got lower by more than the tolerance (10% by default).
+// ----------------------------------------------------------------------------
+
+#include <assimp/Importer.hpp>
+#include <assimp/Exporter.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <assimp/cexport.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <algorithm>
+#include <iomanip>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+
+#include "assimp2json.h"
+#include "mesh_splitter.h"
+#include "mmap_io_system.h"
+#include "stats.h"
+
+// number of times each timed step is repeated, the fastest run counts
+#define REPETITIONS 5
+
+// times below this many milliseconds are too noisy to flag regressions on. Neither they nor the
+// throughputs of benchmarks which only have such times are compared against the baseline.
+#define MIN_COMPARED_TIME_MS 1.
+
+// the sample meshes are small, so they are split with a lower limit to exercise the splitter
+#define SAMPLE_SPLIT_LIMIT 1024
+
+namespace {
+
+struct Result
+{
+	std::string benchmark, metric, unit;
+	double value;
+};
+
+// everything passed to Report(), for --output and --compare
+std::vector<Result> results;
+
+// ------------------------------------------------------------------------------------------------
+double Seconds()
+{
+	typedef std::chrono::steady_clock clock;
+	static const clock::time_point start = clock::now();
+	return std::chrono::duration<double>(clock::now() - start).count();
+}
+
+// ------------------------------------------------------------------------------------------------
+void Report(const std::string& benchmark, const char* metric, double value, const char* unit)
+{
+	// counts are printed as integers, everything else with a fixed number of decimals
+	std::ostringstream s;
+	if (value == std::floor(value) && std::fabs(value) < 1e15) {
+		s << static_cast<long long>(value);
+	}
+	else {
+		s << std::fixed << std::setprecision(3) << value;
+	}
+	std::cout << benchmark << " " << metric << " " << s.str() << " " << unit << std::endl;
+
+	Result r;
+	r.benchmark = benchmark;
+	r.metric = metric;
+	r.unit = unit;
+	r.value = value;
+	results.push_back(r);
+}
+
+// ------------------------------------------------------------------------------------------------
+bool ReadResults(const char* file, std::vector<Result>& out)
+{
+	std::ifstream in(file);
+	if (!in) {
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(in, line)) {
+		std::istringstream ss(line);
+		Result r;
+		if (ss >> r.benchmark >> r.metric >> r.value >> r.unit) {
+			out.push_back(r);
+		}
+	}
+	return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+bool WriteResults(const char* file)
+{
+	std::ofstream out(file);
+	for (std::vector<Result>::const_iterator it = results.begin(); it != results.end(); ++it) {
+		out << (*it).benchmark << " " << (*it).metric << " " << std::setprecision(17) << (*it).value << " " << (*it).unit << "\n";
+	}
+	return static_cast<bool>(out);
+}
+
+// ------------------------------------------------------------------------------------------------
+// Compares the results of this run against a baseline. Times (ms) and throughputs (x/s) are
+// compared against the tolerance, other metrics are only reported if they changed. Returns
+// the number of regressions.
+unsigned int CompareResults(const std::vector<Result>& baseline, double tolerance)
+{
+	unsigned int regressions = 0;
+	for (std::vector<Result>::const_iterator it = results.begin(); it != results.end(); ++it) {
+		const Result& cur = *it;
+
+		// the longest time of the benchmark, in this run
+		double longest = 0.;
+		for (std::vector<Result>::const_iterator other = results.begin(); other != results.end(); ++other) {
+			if ((*other).benchmark == cur.benchmark && (*other).unit == "ms") {
+				longest = std::max(longest, (*other).value);
+			}
+		}
+
+		std::vector<Result>::const_iterator base = baseline.begin();
+		for (; base != baseline.end(); ++base) {
+			if ((*base).benchmark == cur.benchmark && (*base).metric == cur.metric && (*base).unit == cur.unit) {
+				break;
+			}
+		}
+		if (base == baseline.end()) {
+			std::cerr << "new        " << cur.benchmark << " " << cur.metric << "\n";
+			continue;
+		}
+
+		const bool is_time = cur.unit == "ms";
+		const bool is_rate = cur.unit.size() > 2 && !cur.unit.compare(cur.unit.size() - 2, 2, "/s");
+		const double change = (*base).value ? (cur.value - (*base).value) / (*base).value * 100. : 0.;
+
+		// throughputs count as timed if the benchmark reports any time at all
+		const bool too_short = is_time ? std::max(cur.value, (*base).value) < MIN_COMPARED_TIME_MS
+			: is_rate && longest > 0. && longest < MIN_COMPARED_TIME_MS;
+
+		const char* verdict = NULL;
+		if ((is_time || is_rate) && !too_short) {
+			const double slowdown = is_time ? change : -change;
+			if (slowdown > tolerance) {
+				verdict = "regression ";
+				++regressions;
+			}
+			else if (slowdown < -tolerance) {
+				verdict = "improvement";
+			}
+		}
+		else if (cur.value != (*base).value) {
+			verdict = "changed    ";
+		}
+
+		if (verdict) {
+			std::ostringstream pct;
+			pct << std::showpos << std::fixed << std::setprecision(1) << change;
+			std::cerr << verdict << " " << cur.benchmark << " " << cur.metric << " " << (*base).value << " -> " << cur.value
+				<< " " << cur.unit << " (" << pct.str() << "%)\n";
+		}
+	}
+	std::cerr << regressions << " regression(s) against the baseline, tolerance " << tolerance << "%" << std::endl;
+	return regressions;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Reads a large file through an Assimp::IOSystem the way loaders which take the whole file at
+// once do, reporting the time to the first 4 KiB, the time to read everything and the peak
+// growth of the resident set size while doing so, which is sampled every millisecond. The file
+// was just written, so it is read from the page cache.
+void BenchInputIO(const char* filter, const std::string& file, size_t size, const char* handler, Assimp::IOSystem* io)
+{
+	std::ostringstream name;
+	name << "input_io_" << (size >> 20) << "mb_" << handler;
+	if (!strstr(name.str().c_str(), filter)) {
+		return;
+	}
+	if (!io) {
+		std::cerr << name.str() << ": no IOSystem" << std::endl;
+		return;
+	}
+
+	const size_t rss_before = ConversionStats::GetCurrentRSS();
+	std::atomic<size_t> rss_peak(rss_before);
+	std::atomic<bool> done(false);
+	std::thread sampler([&]() {
+		while (!done) {
+			const size_t rss = ConversionStats::GetCurrentRSS();
+			if (rss > rss_peak) {
+				rss_peak = rss;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	});
+
+	double first_byte = 0., time = 0.;
+	bool ok = true;
+	for (unsigned int i = 0; i < REPETITIONS && ok; ++i) {
+		const double start = Seconds();
+		Assimp::IOStream* const stream = io->Open(file.c_str(), "rb");
+
+		std::vector<char> data;
+		double head_time = 0.;
+		if (stream) {
+			char head[4096];
+			stream->Read(head, 1, sizeof head);
+			head_time = Seconds() - start;
+
+			data.resize(stream->FileSize());
+			stream->Seek(0, aiOrigin_SET);
+			stream->Read(&data[0], 1, data.size());
+			io->Close(stream);
+		}
+		const double t = Seconds() - start;
+
+		ok = stream && data.size() == size;
+		first_byte = i ? std::min(first_byte, head_time) : head_time;
+		time = i ? std::min(time, t) : t;
+	}
+
+	done = true;
+	sampler.join();
+
+	if (!ok) {
+		std::cerr << name.str() << ": failure reading " << file << std::endl;
+		return;
+	}
+
+	Report(name.str(), "time_to_first_byte", first_byte * 1e3, "ms");
+	Report(name.str(), "read_time", time * 1e3, "ms");
+	Report(name.str(), "throughput", size / time / (1 << 20), "MB/s");
+	Report(name.str(), "peak_rss_growth", (rss_peak - rss_before) / double(1 << 20), "MB");
+}
+
+// ------------------------------------------------------------------------------------------------
+// Compares assimp's default IOSystem with MappedFileIOSystem on a file of `mb` megabytes
+void BenchInputIOHandlers(const char* filter, size_t mb)
+{
+	std::ostringstream prefix;
+	prefix << "input_io_" << mb << "mb_";
+	if (!strstr((prefix.str() + "default").c_str(), filter) && !strstr((prefix.str() + "mmap").c_str(), filter)) {
+		return;
+	}
+
+	const std::string file = "assimp2json_bench_input.bin";
+	const size_t size = mb << 20;
+	{
+		std::vector<char> block(1 << 20);
+		for (size_t i = 0; i < block.size(); ++i) {
+			block[i] = static_cast<char>(i * 7);
+		}
+
+		FILE* const out = fopen(file.c_str(), "wb");
+		if (!out) {
+			std::cerr << "input_io: cannot create " << file << std::endl;
+			return;
+		}
+		for (size_t written = 0; written < size; written += block.size()) {
+			fwrite(&block[0], 1, block.size(), out);
+		}
+		fclose(out);
+	}
+
+	// the importer's IOSystem is assimp's default one
+	Assimp::Importer imp;
+	BenchInputIO(filter, file, size, "default", imp.GetIOHandler());
+
+	MappedFileIOSystem mapped;
+	BenchInputIO(filter, file, size, "mmap", &mapped);
+
+	remove(file.c_str());
+}
+
+// ------------------------------------------------------------------------------------------------
+// a mesh of `tris` unconnected triangles
+aiMesh* MakeTriangleSoup(unsigned int tris)
+{
+	aiMesh* const mesh = new aiMesh();
+	mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+	mesh->mNumVertices = tris * 3;
+	mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+	mesh->mNumFaces = tris;
+	mesh->mFaces = new aiFace[tris];
+
+	for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
+		mesh->mVertices[i] = aiVector3D(static_cast<float>(i / 3), static_cast<float>(i % 3), 0.f);
+	}
+	for (unsigned int i = 0; i < tris; ++i) {
+		aiFace& face = mesh->mFaces[i];
+		face.mNumIndices = 3;
+		face.mIndices = new unsigned int[3];
+		for (unsigned int v = 0; v < 3; ++v) {
+			face.mIndices[v] = i * 3 + v;
+		}
+	}
+	return mesh;
+}
+
+// ------------------------------------------------------------------------------------------------
+// a regular grid of n x n quads, each made of two triangles. If `shuffle` is set, the
+// faces are in random order, as if from a file which does not preserve spatial locality.
+aiMesh* MakeGrid(unsigned int n, bool shuffle)
+{
+	aiMesh* const mesh = new aiMesh();
+	mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+	mesh->mNumVertices = (n + 1) * (n + 1);
+	mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+	mesh->mNumFaces = n * n * 2;
+	mesh->mFaces = new aiFace[mesh->mNumFaces];
+
+	for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
+		mesh->mVertices[i] = aiVector3D(static_cast<float>(i % (n + 1)), static_cast<float>(i / (n + 1)), 0.f);
+	}
+
+	std::vector<unsigned int> order(mesh->mNumFaces);
+	for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
+		order[i] = i;
+	}
+	if (shuffle) {
+		// fixed seed so that runs are comparable
+		unsigned int seed = 12345;
+		for (unsigned int i = mesh->mNumFaces - 1; i > 0; --i) {
+			seed = seed * 1664525u + 1013904223u;
+			std::swap(order[i], order[seed % (i + 1)]);
+		}
+	}
+
+	for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
+		const unsigned int quad = order[i] / 2, x = quad % n, y = quad / n;
+		const unsigned int v = y * (n + 1) + x;
+
+		aiFace& face = mesh->mFaces[i];
+		face.mNumIndices = 3;
+		face.mIndices = new unsigned int[3];
+		if (order[i] % 2) {
+			face.mIndices[0] = v;
+			face.mIndices[1] = v + 1;
+			face.mIndices[2] = v + n + 2;
+		}
+		else {
+			face.mIndices[0] = v;
+			face.mIndices[1] = v + n + 2;
+			face.mIndices[2] = v + n + 1;
+		}
+	}
+	return mesh;
+}
+
+// ------------------------------------------------------------------------------------------------
+// a flat scene graph with one child node per mesh, as is typical for CAD exports
+aiScene* MakeWideScene(unsigned int meshes, unsigned int tris)
+{
+	aiScene* const scene = new aiScene();
+	scene->mNumMeshes = meshes;
+	scene->mMeshes = new aiMesh*[meshes];
+
+	aiNode* const root = scene->mRootNode = new aiNode();
+	root->mNumChildren = meshes;
+	root->mChildren = new aiNode*[meshes];
+
+	for (unsigned int i = 0; i < meshes; ++i) {
+		scene->mMeshes[i] = MakeTriangleSoup(tris);
+
+		aiNode* const node = root->mChildren[i] = new aiNode();
+		node->mParent = root;
+		node->mNumMeshes = 1;
+		node->mMeshes = new unsigned int[1];
+		node->mMeshes[0] = i;
+	}
+	return scene;
+}
+
+// ------------------------------------------------------------------------------------------------
+// MeshSplitter on a wide scene in which every mesh is split in two, so that every
+// node reference needs to be remapped.
+void BenchSplitterWide(const char* filter, unsigned int meshes)
+{
+	std::ostringstream name;
+	name << "splitter_wide_" << meshes;
+	if (!strstr(name.str().c_str(), filter)) {
+		return;
+	}
+
+	// the splitter works in place, so every run gets a fresh scene
+	double time = 0.;
+	unsigned int meshes_out = 0;
+	for (unsigned int i = 0; i < REPETITIONS; ++i) {
+		aiScene* const scene = MakeWideScene(meshes, 32);
+
+		MeshSplitter splitter;
+		splitter.SetLimit(48);
+
+		const double start = Seconds();
+		splitter.Execute(scene);
+		const double t = Seconds() - start;
+
+		time = i ? std::min(time, t) : t;
+		meshes_out = scene->mNumMeshes;
+		delete scene;
+	}
+
+	Report(name.str(), "nodes", meshes, "count");
+	Report(name.str(), "meshes_out", meshes_out, "count");
+	Report(name.str(), "time", time * 1e3, "ms");
+	Report(name.str(), "throughput", meshes / time, "nodes/s");
+}
+
+// ------------------------------------------------------------------------------------------------
+// MeshSplitter on `meshes` meshes which are split into many parts of the default size each,
+// using one thread per core.
+void BenchSplitterLarge(const char* filter, unsigned int meshes, unsigned int tris)
+{
+	std::ostringstream name;
+	name << "splitter_large_" << meshes << "x" << tris;
+	if (!strstr(name.str().c_str(), filter)) {
+		return;
+	}
+
+	const unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+
+	double time = 0.;
+	unsigned int meshes_out = 0;
+	for (unsigned int i = 0; i < REPETITIONS; ++i) {
+		aiScene* const scene = MakeWideScene(meshes, tris);
+
+		MeshSplitter splitter;
+		splitter.SetLimit(1 << 16);
+		splitter.SetThreads(threads);
+
+		const double start = Seconds();
+		splitter.Execute(scene);
+		const double t = Seconds() - start;
+
+		time = i ? std::min(time, t) : t;
+		meshes_out = scene->mNumMeshes;
+		delete scene;
+	}
+
+	Report(name.str(), "threads", threads, "count");
+	Report(name.str(), "vertices", meshes * tris * 3., "count");
+	Report(name.str(), "meshes_out", meshes_out, "count");
+	Report(name.str(), "time", time * 1e3, "ms");
+	Report(name.str(), "throughput", meshes * tris * 3. / time, "vertices/s");
+}
+
+// ------------------------------------------------------------------------------------------------
+// Quality of the parts produced by MeshSplitter for each split strategy, on a grid whose faces
+// are in scan line or random order.
+void BenchSplitterGrid(const char* filter, unsigned int n, bool shuffle, bool locality, bool optimize_cache)
+{
+	std::ostringstream name;
+	name << "splitter_grid_" << n << (shuffle ? "_shuffled" : "_ordered") << (locality ? "_locality" : "_sequential")
+		<< (optimize_cache ? "_cache" : "");
+	if (!strstr(name.str().c_str(), filter)) {
+		return;
+	}
+
+	double time = 0.;
+	MeshSplitter::Stats stats;
+	for (unsigned int i = 0; i < REPETITIONS; ++i) {
+		aiScene* const scene = MakeWideScene(0, 0);
+		scene->mNumMeshes = 1;
+		scene->mMeshes = new aiMesh*[1];
+		scene->mMeshes[0] = MakeGrid(n, shuffle);
+
+		MeshSplitter splitter;
+		splitter.SetLimit(1 << 16);
+		splitter.SetLocalityAware(locality);
+		splitter.SetOptimizeVertexCache(optimize_cache);
+
+		const double start = Seconds();
+		splitter.Execute(scene);
+		const double t = Seconds() - start;
+
+		time = i ? std::min(time, t) : t;
+		stats = splitter.GetStats();
+		delete scene;
+	}
+
+	Report(name.str(), "meshes_out", stats.parts, "count");
+	Report(name.str(), "duplication", stats.GetDuplicationRatio() * 100., "%");
+	Report(name.str(), "acmr_before", stats.GetACMRBefore(), "misses/triangle");
+	Report(name.str(), "acmr_after", stats.GetACMRAfter(), "misses/triangle");
+	Report(name.str(), "time", time * 1e3, "ms");
+}
+
+// ------------------------------------------------------------------------------------------------
+// MeshSplitter with limits down to a single vertex, below the size of a triangle. Every part then
+// holds exactly one face, which must all be kept.
+void BenchSplitterTiny(const char* filter, unsigned int n, unsigned int limit, bool locality)
+{
+	std::ostringstream name;
+	name << "splitter_tiny_" << n << "_limit_" << limit << (locality ? "_locality" : "_sequential");
+	if (!strstr(name.str().c_str(), filter)) {
+		return;
+	}
+
+	double time = 0.;
+	MeshSplitter::Stats stats;
+	for (unsigned int i = 0; i < REPETITIONS; ++i) {
+		aiScene* const scene = MakeWideScene(0, 0);
+		scene->mNumMeshes = 1;
+		scene->mMeshes = new aiMesh*[1];
+		scene->mMeshes[0] = MakeGrid(n, false);
+
+		MeshSplitter splitter;
+		splitter.SetLimit(limit);
+		splitter.SetLocalityAware(locality);
+
+		const double start = Seconds();
+		splitter.Execute(scene);
+		const double t = Seconds() - start;
+
+		time = i ? std::min(time, t) : t;
+		stats = splitter.GetStats();
+		delete scene;
+	}
+
+	if (stats.triangles_out != stats.triangles_in) {
+		std::cerr << name.str() << ": " << stats.triangles_in << " triangles in, " << stats.triangles_out << " out" << std::endl;
+	}
+	Report(name.str(), "meshes_out", stats.parts, "count");
+	Report(name.str(), "triangles_out", static_cast<double>(stats.triangles_out), "count");
+	Report(name.str(), "time", time * 1e3, "ms");
+}
+
+// ------------------------------------------------------------------------------------------------
+// Complete export of a large grid mesh with a given split limit (0: no splitting), optionally
+// with quantized vertex attributes
+void BenchExportSplitLimit(const char* filter, unsigned int n, unsigned int split_limit, bool quantize = false)
+{
+	std::ostringstream name;
+	name << "export_grid_" << n << "_split_" << split_limit << (quantize ? "_quantized" : "");
+	if (!strstr(name.str().c_str(), filter)) {
+		return;
+	}
+
+	aiScene* const scene = MakeWideScene(0, 0);
+	scene->mNumMeshes = 1;
+	scene->mMeshes = new aiMesh*[1];
+	scene->mMeshes[0] = MakeGrid(n, false);
+	scene->mRootNode->mNumMeshes = 1;
+	scene->mRootNode->mMeshes = new unsigned int[1];
+	scene->mRootNode->mMeshes[0] = 0;
+
+	Assimp::Exporter exp;
+	exp.RegisterExporter(Assimp2Json_desc);
+
+	Assimp::ExportProperties props;
+	props.SetPropertyInteger(ASSIMP2JSON_CONFIG_SPLIT_LIMIT, split_limit);
+	props.SetPropertyBool(ASSIMP2JSON_CONFIG_QUANTIZE, quantize);
+
+	// the exporter leaves the scene untouched, so it is reused for every run
+	double time = 0.;
+	const aiExportDataBlob* blob = NULL;
+	for (unsigned int i = 0; i < REPETITIONS; ++i) {
+		const double start = Seconds();
+		blob = exp.ExportToBlob(scene, "assimp.json", 0u, &props);
+		const double t = Seconds() - start;
+
+		if (!blob) {
+			break;
+		}
+		time = i ? std::min(time, t) : t;
+	}
+
+	if (blob) {
+		Report(name.str(), "bytes", static_cast<double>(blob->size), "B");
+		Report(name.str(), "time", time * 1e3, "ms");
+		Report(name.str(), "throughput", blob->size / time / (1 << 20), "MB/s");
+		Report(name.str(), "vertex_throughput", scene->mMeshes[0]->mNumVertices / time, "vertices/s");
+	}
+	delete scene;
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t CountVertices(const aiScene* scene)
+{
+	size_t vertices = 0;
+	for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+		vertices += scene->mMeshes[i]->mNumVertices;
+	}
+	return vertices;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Splitting and serializing an imported scene, measured separately. Splitting works on a
+// deep copy of the scene so that every repetition starts from the same meshes, serializing
+// does not split and goes straight to memory so that it measures the writer alone.
+void BenchSplitAndSerialize(const std::string& name, const aiScene* scene, unsigned int split_limit)
+{
+	const double vertices = static_cast<double>(CountVertices(scene));
+
+	double split_time = 0.;
+	unsigned int meshes_out = 0;
+	for (unsigned int i = 0; i < REPETITIONS; ++i) {
+		aiScene* copy = NULL;
+		aiCopyScene(scene, &copy);
+
+		MeshSplitter splitter;
+		splitter.SetLimit(split_limit);
+
+		const double start = Seconds();
+		splitter.Execute(copy);
+		const double time = Seconds() - start;
+
+		split_time = i ? std::min(split_time, time) : time;
+		meshes_out = copy->mNumMeshes;
+		aiFreeScene(copy);
+	}
+
+	Report(name, "split_limit", split_limit, "vertices");
+	Report(name, "split_meshes_out", meshes_out, "count");
+	Report(name, "split_time", split_time * 1e3, "ms");
+	Report(name, "split_throughput", vertices / split_time, "vertices/s");
+
+	Assimp2JsonOptions options;
+	options.split_limit = 0;
+
+	double serialize_time = 0.;
+	size_t bytes = 0;
+	for (unsigned int i = 0; i < REPETITIONS; ++i) {
+		std::string json;
+		Assimp2JsonBufferSink sink(json);
+		std::string error;
+
+		const double start = Seconds();
+		const bool ok = Assimp2JsonWrite(scene, sink, options, &error);
+		const double time = Seconds() - start;
+
+		if (!ok) {
+			std::cerr << name << ": export failed: " << error << std::endl;
+			return;
+		}
+		serialize_time = i ? std::min(serialize_time, time) : time;
+		bytes = json.size();
+	}
+
+	Report(name, "serialize_bytes", static_cast<double>(bytes), "B");
+	Report(name, "serialize_time", serialize_time * 1e3, "ms");
+	Report(name, "serialize_throughput", bytes / serialize_time / (1 << 20), "MB/s");
+	Report(name, "serialize_vertex_throughput", vertices / serialize_time, "vertices/s");
+}
+
+// ------------------------------------------------------------------------------------------------
+// Reports the import metrics shared by the sample and synthetic pipeline benchmarks
+void ReportImport(const std::string& name, const aiScene* scene, size_t input_bytes, double time)
+{
+	Report(name, "input_bytes", static_cast<double>(input_bytes), "B");
+	Report(name, "meshes", scene->mNumMeshes, "count");
+	Report(name, "vertices", static_cast<double>(CountVertices(scene)), "count");
+	Report(name, "import_time", time * 1e3, "ms");
+	Report(name, "import_throughput", input_bytes / time / (1 << 20), "MB/s");
+	Report(name, "import_vertex_throughput", CountVertices(scene) / time, "vertices/s");
+}
+
+// ------------------------------------------------------------------------------------------------
+// Import, split and serialize throughput on one of the files in samples/. Files are
+// imported with the same post-processing preset as the command line tool's default profile.
+void BenchSample(const char* filter, const std::string& dir, const char* file)
+{
+	const std::string name = std::string("sample_") + file;
+	if (!strstr(name.c_str(), filter)) {
+		return;
+	}
+
+	const std::string path = dir + "/" + file;
+	std::ifstream in(path.c_str(), std::ios::binary | std::ios::ate);
+	if (!in) {
+		std::cerr << name << ": cannot open " << path << std::endl;
+		return;
+	}
+	const size_t input_bytes = static_cast<size_t>(in.tellg());
+
+	Assimp::Importer imp;
+	double time = 0.;
+	for (unsigned int i = 0; i < REPETITIONS; ++i) {
+		imp.FreeScene();
+
+		const double start = Seconds();
+		const aiScene* const scene = imp.ReadFile(path, aiProcessPreset_TargetRealtime_MaxQuality);
+		const double t = Seconds() - start;
+
+		if (!scene) {
+			std::cerr << name << ": import failed: " << imp.GetErrorString() << std::endl;
+			return;
+		}
+		time = i ? std::min(time, t) : t;
+	}
+
+	ReportImport(name, imp.GetScene(), input_bytes, time);
+	BenchSplitAndSerialize(name, imp.GetScene(), SAMPLE_SPLIT_LIMIT);
+}
+
+// ------------------------------------------------------------------------------------------------
+// Import, split and serialize throughput on an n x n grid written as Wavefront OBJ text, to
+// see how the pipeline scales to meshes far larger than the samples.
+void BenchSyntheticObj(const char* filter, unsigned int n)
+{
+	std::ostringstream name;
+	name << "synthetic_obj_grid_" << n;
+	if (!strstr(name.str().c_str(), filter)) {
+		return;
+	}
+
+	std::ostringstream obj;
+	for (unsigned int y = 0; y <= n; ++y) {
+		for (unsigned int x = 0; x <= n; ++x) {
+			obj << "v " << x << " " << y << " 0\nvt " << static_cast<float>(x) / n << " " << static_cast<float>(y) / n << "\n";
+		}
+	}
+	for (unsigned int y = 0; y < n; ++y) {
+		for (unsigned int x = 0; x < n; ++x) {
+			// OBJ indices are 1-based
+			const unsigned int v = y * (n + 1) + x + 1;
+			obj << "f " << v << "/" << v << " " << v + 1 << "/" << v + 1 << " " << v + n + 2 << "/" << v + n + 2
+				<< " " << v + n + 1 << "/" << v + n + 1 << "\n";
+		}
+	}
+	const std::string text = obj.str();
+
+	Assimp::Importer imp;
+	double time = 0.;
+	for (unsigned int i = 0; i < REPETITIONS; ++i) {
+		imp.FreeScene();
+
+		const double start = Seconds();
+		const aiScene* const scene = imp.ReadFileFromMemory(text.data(), text.size(),
+			aiProcessPreset_TargetRealtime_MaxQuality & ~aiProcess_SplitLargeMeshes, "obj");
+		const double t = Seconds() - start;
+
+		if (!scene) {
+			std::cerr << name.str() << ": import failed: " << imp.GetErrorString() << std::endl;
+			return;
+		}
+		time = i ? std::min(time, t) : t;
+	}
+
+	ReportImport(name.str(), imp.GetScene(), text.size(), time);
+	BenchSplitAndSerialize(name.str(), imp.GetScene(), 1 << 16);
+}
+
+} // !anon
+
+// ------------------------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	const char* filter = "";
+	const char* samples = NULL;
+	const char* output = NULL;
+	const char* compare = NULL;
+	double tolerance = 10.;
+	size_t io_size = 256;
+
+	for (int i = 1; i < argc; ++i) {
+		const bool has_value = i + 1 < argc;
+		if (!strcmp(argv[i], "--samples") && has_value) {
+			samples = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--output") && has_value) {
+			output = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--compare") && has_value) {
+			compare = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--tolerance") && has_value) {
+			tolerance = atof(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--io-size") && has_value) {
+			io_size = static_cast<size_t>(std::max(1, atoi(argv[++i])));
+		}
+		else if (argv[i][0] == '-') {
+			std::cerr << "usage: assimp2json_bench [--samples dir] [--output file] [--io-size MB] [--compare baseline] [--tolerance percent] [filter]" << std::endl;
+			return 2;
+		}
+		else {
+			filter = argv[i];
+		}
+	}
+
+	// read the baseline first so that --output and --compare may name the same file
+	std::vector<Result> baseline;
+	const bool have_baseline = compare && ReadResults(compare, baseline);
+
+	// first, while the process is still small, so that the memory figures are not skewed
+	BenchInputIOHandlers(filter, io_size);
+
+	BenchSplitterWide(filter, 1000);
+	BenchSplitterWide(filter, 10000);
+	BenchSplitterWide(filter, 50000);
+
+	BenchSplitterLarge(filter, 1, 1000000);
+	BenchSplitterLarge(filter, 1, 4000000);
+	BenchSplitterLarge(filter, 16, 250000);
+
+	for (int shuffle = 0; shuffle < 2; ++shuffle) {
+		BenchSplitterGrid(filter, 1000, shuffle != 0, false, false);
+		BenchSplitterGrid(filter, 1000, shuffle != 0, true, false);
+		BenchSplitterGrid(filter, 1000, shuffle != 0, true, true);
+	}
+
+	for (unsigned int limit = 1; limit <= 3; ++limit) {
+		BenchSplitterTiny(filter, 100, limit, false);
+		BenchSplitterTiny(filter, 100, limit, true);
+	}
+
+	BenchExportSplitLimit(filter, 1000, 1 << 16);
+	BenchExportSplitLimit(filter, 1000, 1 << 20);
+	BenchExportSplitLimit(filter, 1000, 0);
+	BenchExportSplitLimit(filter, 1000, 0, true);
+
+	if (samples) {
+		static const char* const sample_files[] = {
+			"teapots.DAE", "Animated.x", "spider.obj", "EmbeddedTexture.blend", "COLLADA.dae"
+		};
+		for (size_t i = 0; i < sizeof(sample_files) / sizeof(sample_files[0]); ++i) {
+			BenchSample(filter, samples, sample_files[i]);
+		}
+	}
+
+	BenchSyntheticObj(filter, 250);
+	BenchSyntheticObj(filter, 1000);
+
+	if (output && !WriteResults(output)) {
+		std::cerr << "failed to write results to " << output << std::endl;
+		return 2;
+	}
+
+	if (compare) {
+		if (!have_baseline) {
+			std::cerr << "no baseline at " << compare << ", nothing to compare" << std::endl;
+			return 0;
+		}
+		return CompareResults(baseline, tolerance) ? 1 : 0;
+	}
+	return 0;
+}